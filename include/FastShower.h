@@ -1,37 +1,120 @@
 #include <random>
 #include <vector>
 #include <functional>
+#include <algorithm>
 
 #include <iostream>
 
 #include "VMCFastSim/FastSim.h"
 
+#include "FastShowerLibrary.h"
+#include "FastShowerSampler.h"
+
 
 class FastShower : public vmcfastsim::base::FastSim<FastShower>
 {
   public:
     FastShower(double mean, double sigma, std::function<void(double)> f)
-      : FastSim(vmcfastsim::base::EKernelMode::kHITS, "FastShower"), mDistribution(mean, sigma), mStoreHit(f)
+      : FastSim(vmcfastsim::base::EKernelMode::kHITS, "FastShower"), mDistribution(mean, sigma), mStoreHit(f),
+        mLibrary(nullptr)
+    {
+    }
+    /// Energy-dependent mode: mean and sigma are interpolated linearly in the
+    /// kinetic energy of the particle between the calibration points
+    FastShower(const std::vector<double>& energies, const std::vector<double>& means,
+               const std::vector<double>& sigmas, std::function<void(double)> f)
+      : FastSim(vmcfastsim::base::EKernelMode::kHITS, "FastShower"), mStoreHit(f), mLibrary(nullptr),
+        mEnergies(energies), mMeans(means), mSigmas(sigmas)
+    {
+    }
+    /// Table mode: the deposit is drawn from a binned distribution, e.g. the
+    /// energy deposit histogram of a full simulation
+    FastShower(const FastShowerSampler& sampler, std::function<void(double)> f)
+      : FastSim(vmcfastsim::base::EKernelMode::kHITS, "FastShower"), mStoreHit(f), mLibrary(nullptr),
+        mSampler(sampler)
+    {
+    }
+    /// Library mode: a whole shower profile is sampled and passed on together
+    /// with the factor it has to be scaled with; calorFaceX is the x position
+    /// of the calorimeter face the entry point is taken at
+    FastShower(const FastShowerLibrary* library, double calorFaceX, std::function<void(const float*, double)> f)
+      : FastSim(vmcfastsim::base::EKernelMode::kHITS, "FastShower"), mLibrary(library), mStoreProfile(f),
+        mCalorFaceX(calorFaceX)
     {
     }
     virtual ~FastShower() = default;
 
     virtual bool Process() override final
     {
-      if(GetCurrentParticle()->GetPdgCode() == 2212) {
-        std::cerr << "Role the dice" << std::endl;
+      TParticle* particle = GetCurrentParticle();
+      if(particle->GetPdgCode() == 2212) {
+        if(mLibrary) {
+          double scale = 1.;
+          double y, z;
+          FastShowerLibrary::EntryPoint(*particle, mCalorFaceX, y, z);
+          const float* profile = mLibrary->Sample(particle->Ek(), y, z, mUniform(mGenerator), scale);
+          if(profile) {
+            mStoreProfile(profile, scale);
+          } else {
+            std::cerr << "No shower in library for kinetic energy " << particle->Ek() << std::endl;
+          }
+          return true;
+        }
+        if(!mSampler.IsEmpty()) {
+          mStoreHit(mSampler.Sample(mUniform(mGenerator), mUniform(mGenerator)));
+          return true;
+        }
+        if(!mEnergies.empty()) {
+          double mean, sigma;
+          Interpolate(particle->Ek(), mean, sigma);
+          mStoreHit(mDistribution(mGenerator, std::normal_distribution<double>::param_type(mean, sigma)));
+          return true;
+        }
         mStoreHit(mDistribution(mGenerator));
       }
       return true;
     }
+    /// Seed the random engine to get reproducible energy deposits
+    void SetSeed(unsigned int seed)
+    {
+      mGenerator.seed(seed);
+    }
     virtual void Stop() override final
     {
       // Nothing to be done yet
     }
 
+  private:
+    /// Interpolate mean and sigma at a given energy, constant outside the
+    /// calibrated range
+    void Interpolate(double energy, double& mean, double& sigma) const
+    {
+      std::size_t upper = std::upper_bound(mEnergies.begin(), mEnergies.end(), energy) - mEnergies.begin();
+      if(upper == 0 || upper == mEnergies.size()) {
+        std::size_t i = upper == 0 ? 0 : mEnergies.size() - 1;
+        mean = mMeans[i];
+        sigma = mSigmas[i];
+        return;
+      }
+      double fraction = (energy - mEnergies[upper-1]) / (mEnergies[upper] - mEnergies[upper-1]);
+      mean = mMeans[upper-1] + fraction * (mMeans[upper] - mMeans[upper-1]);
+      sigma = mSigmas[upper-1] + fraction * (mSigmas[upper] - mSigmas[upper-1]);
+    }
+
   private:
     /// The bin edges
     std::default_random_engine mGenerator;
     std::normal_distribution<double> mDistribution;
     std::function<void(double)> mStoreHit;
+    /// The shower library (library mode only)
+    const FastShowerLibrary* mLibrary;
+    std::uniform_real_distribution<double> mUniform;
+    std::function<void(const float*, double)> mStoreProfile;
+    double mCalorFaceX = 0.;
+    /// Tables of the deposit distribution (table mode only)
+    FastShowerSampler mSampler;
+    /// Calibration points (energy-dependent mode only), sorted in energy
+    std::vector<double> mEnergies;
+    std::vector<double> mMeans;
+    std::vector<double> mSigmas;
 };
@@ -0,0 +1,67 @@
+#ifndef EXME_ACCUMULATOR_H
+#define EXME_ACCUMULATOR_H
+
+/// \file FastShowerAccumulator.h
+/// \brief Definition of the FastShowerAccumulator class
+///
+/// Lightweight fixed-binning accumulation of histogram entries
+
+#include <vector>
+
+#include <Rtypes.h>
+
+class TH1;
+
+/// \ingroup EME
+/// \brief Accumulates unweighted entries with the fixed binning of a 1D
+/// histogram
+///
+/// Fill() is a bin computation with a precomputed inverse bin width and an
+/// increment of a plain array, without axis lookup, sumw2 or statistics
+/// bookkeeping of TH1::Fill(). The entries are moved into the histogram
+/// with Flush(). Each application instance (and hence each worker thread)
+/// owns its accumulators, so no synchronisation is needed while filling.
+
+class FastShowerAccumulator
+{
+  public:
+    FastShowerAccumulator();
+
+    // methods
+    void  Init(const TH1& histo);
+    void  Flush(TH1& histo);
+    void  Reset();
+
+    /// Add an entry
+    /// \param x  The value
+    void  Fill(Double_t x)
+    {
+      Int_t bin;
+      if (x < fXmin)        bin = 0;
+      else if (x >= fXmax)  bin = fNbins + 1;
+      else {
+        bin = 1 + static_cast<Int_t>((x - fXmin) * fInvBinWidth);
+        // Protect against rounding at the upper edge
+        if (bin > fNbins) bin = fNbins;
+        fSumWX += x;
+        fSumWX2 += x * x;
+        fSumW += 1.;
+      }
+      fContents[bin] += 1.;
+      fEntries += 1.;
+    }
+
+  private:
+    // data members
+    Int_t    fNbins;       ///< Number of bins (without under-/overflow)
+    Double_t fXmin;        ///< Lower edge of the axis
+    Double_t fXmax;        ///< Upper edge of the axis
+    Double_t fInvBinWidth; ///< Inverse of the bin width
+    Double_t fEntries;     ///< Number of entries
+    Double_t fSumW;        ///< Sum of weights within the axis range
+    Double_t fSumWX;       ///< Sum of weight * x within the axis range
+    Double_t fSumWX2;      ///< Sum of weight * x^2 within the axis range
+    std::vector<Double_t> fContents; ///< Bin contents including under-/overflow
+};
+
+#endif //EXME_ACCUMULATOR_H
@@ -20,10 +20,10 @@
 /// \author I. Hrivnacova; IPN, Orsay
 
 #include <TNamed.h>
-#include <TClonesArray.h>
+
+#include <vector>
 
 class FastShowerDetectorConstruction;
-class FastShowerCalorHit;
 class TVirtualMC;
 
 /// \ingroup EME
@@ -34,6 +34,16 @@ class TVirtualMC;
 
 class FastShowerCalorimeterSD : public TNamed
 {
+  public:
+    /// Quantities accounted per cell
+    enum EQuantity {
+      kEdepAbs,      ///< Energy deposit in the absorber
+      kTrakAbs,      ///< Track length in the absorber
+      kEdepGap,      ///< Energy deposit in the gap
+      kTrakGap,      ///< Track length in the gap
+      kNofQuantities ///< Number of quantities
+    };
+
   public:
     FastShowerCalorimeterSD(const char* name,
                       FastShowerDetectorConstruction* detector);
@@ -45,8 +55,12 @@ class FastShowerCalorimeterSD : public TNamed
     // methods
     void    Initialize();
     Bool_t  ProcessHits();
+    Bool_t  AddLocalDeposit(Double_t edep);
     void    EndOfEvent();
     void    SetTotalEdepGap(Double_t sumGapHits);
+    void    AddProfile(const Float_t* profile, Double_t scale);
+    void    AddCellValues(Int_t layer, Int_t cell, const Double_t* values);
+    void    ResetHits();
     Double_t GetTotalEdepGap() const;
     virtual void  Print(Option_t* option = "") const;
     void    PrintTotal() const;
@@ -54,24 +68,41 @@ class FastShowerCalorimeterSD : public TNamed
 
     // set methods
     void SetVerboseLevel(Int_t level);
+    void SetTrackWeight(Double_t weight);
+    void SetCellSegmentation(Int_t nofCellsY, Int_t nofCellsZ);
 
     // get methods
-    FastShowerCalorHit* GetHit(Int_t i) const;
+    Int_t    GetNbOfLayers() const;
+    Int_t    GetNbOfCells() const;
+    Int_t    GetNbOfCellsY() const;
+    Int_t    GetNbOfCellsZ() const;
+    Double_t GetCellValue(Int_t layer, Int_t cell, EQuantity quantity) const;
+    const std::vector<Int_t>& GetTouchedCells() const;
 
   private:
     // methods
-    void  ResetHits();
+    void  AllocateCells();
+    Int_t GetCellIndex(Double_t y, Double_t z) const;
+    Bool_t AddDeposit(Double_t edep, Double_t step);
 
     // data members
     TVirtualMC*    fMC;            ///< The VMC implementation
     FastShowerDetectorConstruction*  fDetector; ///< Detector construction
-    TClonesArray*  fCalCollection; ///< Hits collection
     Int_t          fAbsorberVolId; ///< The absorber volume Id
     Int_t          fGapVolId;      ///< The gap volume Id
     Int_t          fVerboseLevel;  ///< Verbosity level
     Double_t       fTotEGap; ///< Total energy deposited in gap
-
-  ClassDef(FastShowerCalorimeterSD,1) //FastShowerCalorimeterSD
+    Double_t       fTrackWeight;   //!< Weight of the current track
+    Int_t          fNbOfLayers;    ///< Number of layer slots (copy numbers may start from 0 or 1)
+    Int_t          fNbOfCellsY;    ///< Number of cells per layer along y
+    Int_t          fNbOfCellsZ;    ///< Number of cells per layer along z
+    Double_t       fInvCellSizeY;  ///< Inverse of the cell size along y
+    Double_t       fInvCellSizeZ;  ///< Inverse of the cell size along z
+    std::vector<Double_t> fCells;        //!< Accounted quantities indexed by (layer, cell, quantity)
+    std::vector<Int_t>    fTouchedCells; //!< Indices (layer, cell) of cells hit in this event
+    std::vector<Bool_t>   fIsTouched;    //!< Flag per (layer, cell) if in fTouchedCells
+
+  ClassDef(FastShowerCalorimeterSD,2) //FastShowerCalorimeterSD
 
 };
 
@@ -80,4 +111,37 @@ class FastShowerCalorimeterSD : public TNamed
 inline void FastShowerCalorimeterSD::SetVerboseLevel(Int_t level)
 { fVerboseLevel = level; }
 
+/// Set the weight the deposits of the current track are multiplied with
+/// \param weight The weight of the current track
+inline void FastShowerCalorimeterSD::SetTrackWeight(Double_t weight)
+{ fTrackWeight = weight; }
+
+/// \return The number of layer slots
+inline Int_t FastShowerCalorimeterSD::GetNbOfLayers() const
+{ return fNbOfLayers; }
+
+/// \return The number of cells per layer
+inline Int_t FastShowerCalorimeterSD::GetNbOfCells() const
+{ return fNbOfCellsY * fNbOfCellsZ; }
+
+/// \return The number of cells per layer along y
+inline Int_t FastShowerCalorimeterSD::GetNbOfCellsY() const
+{ return fNbOfCellsY; }
+
+/// \return The number of cells per layer along z
+inline Int_t FastShowerCalorimeterSD::GetNbOfCellsZ() const
+{ return fNbOfCellsZ; }
+
+/// \return The accounted quantity of a cell
+/// \param layer     The layer number
+/// \param cell      The cell number in the layer (iy * nofCellsZ + iz)
+/// \param quantity  The quantity
+inline Double_t FastShowerCalorimeterSD::GetCellValue(Int_t layer, Int_t cell,
+                                                     EQuantity quantity) const
+{ return fCells[(layer * GetNbOfCells() + cell) * kNofQuantities + quantity]; }
+
+/// \return The indices (layer * nofCells + cell) of the cells hit in this event
+inline const std::vector<Int_t>& FastShowerCalorimeterSD::GetTouchedCells() const
+{ return fTouchedCells; }
+
 #endif //EXME_CALORIMETER_SD_H
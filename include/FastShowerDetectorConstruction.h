@@ -20,6 +20,7 @@
 /// \author I. Hrivnacova; IPN, Orsay
 
 #include <map>
+#include <vector>
 
 #include <Riostream.h>
 #include <TObject.h>
@@ -35,6 +36,14 @@ class TVirtualMC;
 
 class FastShowerDetectorConstruction : public TObject
 {
+  public:
+    /// A tracking medium parameter (cut or process control) set via Gstpar()
+    struct MediumParameter {
+      TString  fMedium;    ///< Medium name
+      TString  fParameter; ///< Parameter name, e.g. CUTGAM or PAIR
+      Double_t fValue;     ///< Parameter value
+    };
+
   public:
     FastShowerDetectorConstruction();
     virtual ~FastShowerDetectorConstruction();
@@ -43,8 +52,14 @@ class FastShowerDetectorConstruction : public TObject
      void ConstructMaterials();
      void ConstructGeometry();
      void SetCuts();
+     Bool_t ReadCuts(const TString& fileName);
+     void SetCut(const TString& medium, const TString& parameter, Double_t value);
+     void ScaleCuts(const TString& medium, Double_t factor);
+     void PrintCuts() const;
      void SetControls();
      void PrintCalorParameters();
+     Bool_t ImportGeometry(const TString& fileName);
+     Bool_t ExportGeometry(const TString& fileName) const;
      //void UpdateGeometry();
 
      // set methods
@@ -80,9 +95,17 @@ class FastShowerDetectorConstruction : public TObject
      /// \return The gap thickness
      Double_t GetGapThickness()const   { return fGapThickness; }
 
+     /// \return The table of medium parameters applied in SetCuts()
+     const std::vector<MediumParameter>& GetCuts() const { return fCuts; }
+
+     ULong64_t GetParameterHash() const;
+     TString   GetGeometryCacheFile(const TString& directory) const;
+
   private:
      // methods
      void  ComputeCalorParameters();
+     void  SetDefaultCuts();
+     void  ResolveCuts();
 
      // data members
      Int_t     fNbOfLayers;       ///< The number of calorimeter layers
@@ -98,6 +121,10 @@ class FastShowerDetectorConstruction : public TObject
      TString   fAbsorberMaterial; ///< The absorber material name
      TString   fGapMaterial;      ///< The gap material name
 
+     std::vector<MediumParameter> fCuts;    //!< Medium parameters applied in SetCuts()
+     std::vector<Int_t> fCutMediumIds;      //!< Medium ID of each entry of fCuts, 0 if not found
+     Bool_t      fCutsResolved;  //!< If fCutMediumIds is filled
+
      TVirtualMC* fMC; ///< Stored pointer to current TVirtualMC
      Bool_t      fConnectedToMCManager; ///< Set flag if fMC is connected to and
                                         ///< updated by TMCManager
@@ -0,0 +1,87 @@
+#ifndef EXME_EVENT_TREE_H
+#define EXME_EVENT_TREE_H
+
+/// \file FastShowerEventTree.h
+/// \brief Definition of the FastShowerEventTree class
+///
+/// Per-event output of the calorimeter cells and event summaries
+
+#include <string>
+#include <vector>
+
+#include <Rtypes.h>
+
+class TFile;
+class TTree;
+
+/// \ingroup EME
+/// \brief The data stored per event
+///
+/// The calorimeter cells hit in the event are stored sparsely as parallel
+/// arrays, one entry per (layer, cell); without transverse segmentation
+/// this is one entry per layer hit.
+
+struct FastShowerEventData
+{
+  Int_t    fEventNo;           ///< Event number
+  Double_t fTotalEdepGap;      ///< Total energy deposit in the gap
+  Double_t fProtonEnergy;      ///< Energy of the proton leaving the calorimeter, -1 if not monitored
+  Int_t    fBoundaryParticles; ///< Number of particles on the boundary, -1 if not monitored
+  Int_t    fNbOfCellsY;        ///< Number of cells per layer along y
+  Int_t    fNbOfCellsZ;        ///< Number of cells per layer along z
+  std::vector<Int_t>   fLayers;  ///< Layer of each cell hit
+  std::vector<Int_t>   fCells;   ///< Cell number in the layer of each cell hit
+  std::vector<Float_t> fEdepAbs; ///< Energy deposit in the absorber
+  std::vector<Float_t> fTrakAbs; ///< Track length in the absorber
+  std::vector<Float_t> fEdepGap; ///< Energy deposit in the gap
+  std::vector<Float_t> fTrakGap; ///< Track length in the gap
+  std::vector<Int_t>   fMultiplicityPdgs; ///< Species of fMultiplicities
+  std::vector<Int_t>   fMultiplicities;   ///< Multiplicity of each species
+
+  void Clear();
+};
+
+/// \ingroup EME
+/// \brief Writes FastShowerEventData to a split TTree with one branch per
+/// quantity and reads them back
+///
+/// The branches hold plain numbers and std::vector<Int_t/Float_t>, so the
+/// tree can be analysed column-wise without the application library.
+
+class FastShowerEventTree
+{
+  public:
+    FastShowerEventTree();
+    ~FastShowerEventTree();
+
+    // methods
+    Bool_t   OpenForWriting(const std::string& fileName, Int_t basketSize, Int_t compression);
+    Bool_t   OpenForReading(const std::string& fileName);
+    void     Fill(const FastShowerEventData& event);
+    Bool_t   GetEntry(Long64_t i, FastShowerEventData& event);
+    void     Close();
+
+    // get methods
+    Long64_t GetEntries() const;
+    Bool_t   IsWriting() const;
+
+  private:
+    FastShowerEventTree(const FastShowerEventTree&);
+    FastShowerEventTree& operator=(const FastShowerEventTree&);
+
+    void  BindBranches(Int_t basketSize);
+
+    // data members
+    TFile*              fFile;      ///< The output or input file
+    TTree*              fTree;      ///< The tree, owned by fFile
+    Bool_t              fIsWriting; ///< If opened for writing
+    FastShowerEventData fData;      ///< The data the branches are bound to
+    std::vector<std::vector<Int_t>*>   fIntAddresses;   ///< Addresses of the Int_t vector branches
+    std::vector<std::vector<Float_t>*> fFloatAddresses; ///< Addresses of the Float_t vector branches
+};
+
+/// \return True if opened for writing
+inline Bool_t FastShowerEventTree::IsWriting() const
+{ return fIsWriting; }
+
+#endif //EXME_EVENT_TREE_H
@@ -0,0 +1,78 @@
+#ifndef EXME_EVENT_WRITER_H
+#define EXME_EVENT_WRITER_H
+
+/// \file FastShowerEventWriter.h
+/// \brief Definition of the FastShowerEventWriter class
+///
+/// Asynchronous filling of the event tree
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <Rtypes.h>
+
+#include "FastShowerEventTree.h"
+
+/// \ingroup EME
+/// \brief Fills events into a FastShowerEventTree on a dedicated thread
+///
+/// The events are passed through a bounded queue of pre-allocated slots.
+/// Push() swaps the event data with a free slot, so the simulation thread
+/// only pays for the swap of a few vectors; serialisation and compression
+/// happen on the writer thread. If the queue is full, Push() either waits
+/// for a free slot or drops the event.
+
+class FastShowerEventWriter
+{
+  public:
+    FastShowerEventWriter(FastShowerEventTree* tree, Int_t capacity = 64,
+                          Bool_t dropWhenFull = kFALSE);
+    ~FastShowerEventWriter();
+
+    // methods
+    void   Start();
+    Bool_t Push(FastShowerEventData& event);
+    void   Stop();
+    void   Print() const;
+
+    // set methods
+    void   SetCapacity(Int_t capacity);
+    void   SetDropWhenFull(Bool_t dropWhenFull);
+
+  private:
+    FastShowerEventWriter(const FastShowerEventWriter&);
+    FastShowerEventWriter& operator=(const FastShowerEventWriter&);
+
+    /// The clock used for the stall times
+    typedef std::chrono::steady_clock Clock;
+
+    void  Run();
+
+    // data members
+    FastShowerEventTree*             fTree;          ///< The tree filled (not owned)
+    Int_t                            fCapacity;      ///< Number of slots
+    Bool_t                           fDropWhenFull;  ///< Drop instead of waiting if full
+    std::vector<FastShowerEventData> fSlots;         ///< The ring buffer of events
+    Int_t                            fHead;          ///< Slot of the oldest event
+    Int_t                            fDepth;         ///< Number of queued events
+    Bool_t                           fStopping;      ///< If the thread should finish
+    std::thread                      fThread;        ///< The writer thread
+    mutable std::mutex               fMutex;         ///< Protects the queue
+    std::condition_variable          fNotEmpty;      ///< Signalled when an event is queued
+    std::condition_variable          fNotFull;       ///< Signalled when a slot is freed
+
+    // statistics
+    Long64_t         fNbOfWritten;   ///< Number of events filled
+    Long64_t         fNbOfDropped;   ///< Number of events dropped
+    Long64_t         fNbOfStalls;    ///< Number of Push() calls which had to wait
+    Int_t            fMaxDepth;      ///< Maximum queue depth
+    Double_t         fSumDepth;      ///< Sum of the queue depths seen by Push()
+    Clock::duration  fPushWait;      ///< Time the simulation threads waited in Push()
+    Clock::duration  fWriterBusy;    ///< Time the writer spent filling
+    Clock::duration  fWriterIdle;    ///< Time the writer waited for events
+};
+
+#endif //EXME_EVENT_WRITER_H
@@ -0,0 +1,75 @@
+#ifndef EXME_SHOWER_LIBRARY_H
+#define EXME_SHOWER_LIBRARY_H
+
+/// \file FastShowerLibrary.h
+/// \brief Definition of the FastShowerLibrary class
+///
+/// Library of recorded calorimeter shower profiles for the fast simulation
+
+#include <vector>
+
+#include <TObject.h>
+
+class TParticle;
+class FastShowerCalorimeterSD;
+
+/// \ingroup EME
+/// \brief Library of calorimeter shower profiles binned in incident kinetic energy
+/// and transverse entry position
+///
+/// A profile holds the energy deposited in the absorber and in the gap of
+/// every (layer, cell) of the calorimeter SD, stored as
+/// profile[2 * (layer * nofCells + cell) + {0: absorber, 1: gap}].
+/// The profiles of all showers in a bin are concatenated in one array.
+/// Sampled profiles are scaled linearly with the ratio of the requested
+/// to the recorded incident kinetic energy.
+
+class FastShowerLibrary : public TObject
+{
+  public:
+    FastShowerLibrary(const std::vector<Double_t>& energyEdges,
+                      Int_t nofPositionBins, Double_t calorSizeYZ,
+                      const FastShowerCalorimeterSD& calorimeterSD);
+    FastShowerLibrary();
+    virtual ~FastShowerLibrary();
+
+    // static methods
+    static std::vector<Double_t> LogEnergyEdges(Double_t min, Double_t max, Int_t nofBins);
+    static FastShowerLibrary* Load(const char* fileName);
+    static void  EntryPoint(const TParticle& particle, Double_t faceX,
+                            Double_t& y, Double_t& z);
+
+    // methods
+    void            Record(Double_t energy, Double_t y, Double_t z,
+                           const FastShowerCalorimeterSD& calorimeterSD);
+    const Float_t*  Sample(Double_t energy, Double_t y, Double_t z,
+                           Double_t random, Double_t& scale) const;
+    Bool_t          Add(const FastShowerLibrary& other);
+    Bool_t          IsCompatible(const FastShowerCalorimeterSD& calorimeterSD) const;
+    void            WriteToFile(const char* fileName) const;
+    virtual void    Print(Option_t* option = "") const;
+
+    // get methods
+    Int_t  FindBin(Double_t energy, Double_t y, Double_t z) const;
+    Int_t  GetNbOfShowers() const;
+
+    /// \return The number of floats per profile
+    Int_t  GetProfileSize() const { return 2 * fNbOfLayers * fNbOfCellsY * fNbOfCellsZ; }
+
+  private:
+    Int_t  GetPositionBin(Double_t position) const;
+
+    // data members
+    std::vector<Double_t> fEnergyEdges;      ///< Incident kinetic energy bin edges (GeV)
+    Int_t                 fNbOfPositionBins; ///< Number of entry position bins along y and z
+    Double_t              fCalorSizeYZ;      ///< The calorimeter size y,z component
+    Int_t                 fNbOfLayers;       ///< Number of layer slots of the SD
+    Int_t                 fNbOfCellsY;       ///< Number of cells per layer along y
+    Int_t                 fNbOfCellsZ;       ///< Number of cells per layer along z
+    std::vector<std::vector<Float_t> > fEnergies; ///< Recorded incident kinetic energies per bin
+    std::vector<std::vector<Float_t> > fProfiles; ///< Concatenated profiles per bin
+
+  ClassDef(FastShowerLibrary,1) //FastShowerLibrary
+};
+
+#endif //EXME_SHOWER_LIBRARY_H
@@ -17,10 +17,12 @@
 ///
 /// \author I. Hrivnacova; IPN, Orsay
 
+#include <atomic>
 #include <vector>
 #include <unordered_map>
 #include <string>
 #include <functional>
+#include <limits>
 
 #include <initializer_list>
 
@@ -28,14 +30,20 @@
 
 #include "FastShowerDetectorConstruction.h"
 #include "FastShowerCalorimeterSD.h"
+#include "FastShowerMCStack.h"
+#include "FastShowerAccumulator.h"
+#include "FastShowerEventTree.h"
+#include "FastShowerPdgCounter.h"
 
 #include <TGeoUniformMagField.h>
 #include <TMCVerbose.h>
 #include <TH1D.h>
 #include <TH2D.h>
 
-class FastShowerMCStack;
 class FastShowerPrimaryGenerator;
+class FastShowerLibrary;
+class FastShowerTimer;
+class FastShowerEventWriter;
 
 
 /// \ingroup EME
@@ -46,9 +54,59 @@ class FastShowerPrimaryGenerator;
 
 class FastShowerMCApplication : public TVirtualMCApplication
 {
+  public:
+    /// What Stepping() records besides the physics
+    enum EMonitoring {
+      kNoMonitoring,   ///< Only stop, score and route the tracks
+      kStepMonitoring  ///< Also fill the step and boundary histograms and counters
+    };
+
+    /// Actions taken in Stepping() depending on the current volume
+    enum EVolumeAction {
+      kNoAction      = 0,      ///< nothing to be done
+      kStopTrack     = 1 << 0, ///< stop the track (except for primary protons)
+      kMarkLeaving   = 1 << 1, ///< mark the track as leaving when exiting the volume
+      kCountBoundary = 1 << 2, ///< count leaving tracks entering this volume
+      kRecordEngine  = 1 << 3, ///< record engine vs. volume
+      kTransferTrack = 1 << 4  ///< transfer the track to the target engine
+    };
+
+    /// Target engine of the tracks of a given species and energy in a volume
+    struct TransferRule {
+      Int_t    fPdg;            ///< PDG code the rule applies to, 0 for all species
+      Double_t fMaxKinEnergy;   ///< Kinetic energy below which the rule applies (GeV)
+      Int_t    fTargetEngineId; ///< Target engine ID
+    };
+
+    /// Routing of a volume in Stepping()
+    struct VolumeRoute {
+      UInt_t fActions;        ///< Bit mask of EVolumeAction
+      Int_t  fFirstRule;      ///< Index of the first TransferRule of the volume
+      Int_t  fNofRules;       ///< Number of TransferRules, the first matching one applies
+    };
+
+    /// Entry of the routing map, resolved to a TransferRule in InitMC()
+    struct RoutingEntry {
+      std::string fVolume;       ///< Volume name
+      std::string fEngine;       ///< Target engine name
+      Int_t       fPdg;          ///< PDG code, 0 for all species
+      Double_t    fMaxKinEnergy; ///< Kinetic energy below which the entry applies (GeV)
+    };
+
+    /// Threshold below which secondaries of a species created in a medium
+    /// are not tracked, resolved to the medium ID in InitGeometry()
+    struct KillThreshold {
+      std::string fMedium;    ///< Medium name
+      Int_t       fPdg;       ///< PDG code
+      Double_t    fKinEnergy; ///< Kinetic energy threshold (GeV)
+      Double_t    fSurvival;  ///< Survival probability of the Russian roulette, 0 for a local deposit
+    };
+
   public:
     FastShowerMCApplication(const char* name,  const char *title,
-                      Bool_t isMulti = kFALSE, Bool_t splitSimulation = kFALSE, Bool_t hasFastSim = kFALSE);
+                      Bool_t isMulti = kFALSE, Bool_t splitSimulation = kFALSE, Bool_t hasFastSim = kFALSE,
+                      FastShowerMCStack::EStorage stackStorage = FastShowerMCStack::kClonesArray,
+                      FastShowerMCStack::EOrdering stackOrdering = FastShowerMCStack::kLifo);
     FastShowerMCApplication();
     virtual ~FastShowerMCApplication();
 
@@ -81,8 +139,10 @@ class FastShowerMCApplication : public TVirtualMCApplication
     // set methods
     void  SetPrintModulo(Int_t value);
     void  SetVerboseLevel(Int_t verboseLevel);
+    void  SetMonitoringLevel(EMonitoring level);
     void  SetControls(Bool_t isConstrols);
     void  SetField(Double_t bz);
+    void  SetEventOffset(Int_t offset);
 
     // get methods
     FastShowerDetectorConstruction* GetDetectorConstruction() const;
@@ -92,19 +152,77 @@ class FastShowerMCApplication : public TVirtualMCApplication
     // method for tests
     void SetOldGeometry(Bool_t oldGeometry = kTRUE);
 
+    void SetVolumeRoute(const char* volName, UInt_t actions, Int_t targetEngineId = -1);
+    void SetVolumeRoute(const char* volName, UInt_t actions, const std::vector<TransferRule>& rules);
+    void   SetDefaultRoutingMap();
+    void   AddRoutingEntry(const std::string& volume, const std::string& engine, Int_t pdg = 0,
+                           Double_t maxKinEnergy = std::numeric_limits<Double_t>::max());
+    Bool_t ReadRoutingMap(const std::string& fileName);
+    void   PrintRoutingMap() const;
+    void   AddKillThreshold(const std::string& medium, Int_t pdg, Double_t kinEnergy,
+                            Double_t survivalProbability = 0.);
+    Bool_t ReadKillThresholds(const std::string& fileName);
+    void SetMultiplicityPdgs(const std::vector<Int_t>& pdgs);
+    void SetShowerLibrary(FastShowerLibrary* library);
+    void SetTiming(Bool_t timing);
+    void SetTransferThreshold(Double_t kinEnergy);
+    void SetStackCapacity(Int_t capacity);
+    FastShowerTimer* GetTimer() const;
+    Double_t GetRunRealTime() const;
+
     void WriteHistograms(const std::string& filename);
+    void MergeHistograms(const std::string& filename);
+
+    Bool_t SetEventOutput(const std::string& fileName, Int_t basketSize = 32000, Int_t compression = 101);
+    void   SetEventQueue(Int_t capacity, Bool_t dropWhenFull);
+    void   SetGeometryCache(const std::string& directory);
+    Bool_t SetEventInput(const std::string& fileName);
+    Long64_t GetNbOfStoredEvents() const;
 
   private:
+    /// Histograms filled via accumulators in Stepping() and PreTrack()
+    enum EAccumulated {
+      kStepsX, kStepsY, kStepsZ,
+      kPVElectronsX, kPVElectronsY, kPVElectronsZ,
+      kPMomElectronsX, kPMomElectronsY, kPMomElectronsZ,
+      kBoundaryX, kBoundaryY, kBoundaryZ,
+      kNofAccumulated
+    };
+
     // methods
     FastShowerMCApplication(const FastShowerMCApplication& origin);
     void RegisterStack() const;
-
+    void InitVolumeRoutes();
+    const VolumeRoute& GetVolumeRoute(Int_t volId) const;
+    Int_t GetTransferTarget(const VolumeRoute& route, Int_t pdg, Double_t kinEnergy) const;
+    Int_t GetEngineId(const std::string& engineName) const;
+    std::vector<TH1*> GetHistograms();
+    void Merge(FastShowerMCApplication& worker);
+    void RecordShower();
+    void SetTimerEngineNames();
+    void InitTransferHistograms();
+    std::vector<TH1D*> GetAccumulatedHistograms();
+    void InitAccumulators();
+    void FlushAccumulators();
+    void FillEventData();
+    void StoreEvent();
+    void PrintTransfers() const;
+    void SelectStepping();
+    void SteppingPhysics();
+    void SteppingMonitored();
+    void RouteTrack(const VolumeRoute& route, Double_t kinEnergy);
+
+    /// A Stepping() variant
+    typedef void (FastShowerMCApplication::*SteppingFunction)();
 
 
     // data members
     Int_t                     fPrintModulo;     ///< The event modulus number to be printed
     Int_t                     fEventNo;         ///< Event counter
+    std::atomic<Int_t>        fNextEventNo;     //!< Number of the last event begun (used on master)
     TMCVerbose                fVerbose;         ///< VMC verbose helper
+    EMonitoring               fMonitoringLevel; ///< What is recorded per step
+    SteppingFunction          fStepping;        //!< The Stepping() variant selected for fMonitoringLevel
     FastShowerMCStack*              fStack;           ///< VMC stack
     FastShowerDetectorConstruction* fDetConstruction; ///< Dector construction
     FastShowerCalorimeterSD*        fCalorimeterSD;   ///< Calorimeter SD
@@ -119,11 +237,29 @@ class FastShowerMCApplication : public TVirtualMCApplication
     Int_t                     fG3Id;            ///< engine ID of Geant3
     Int_t                     fG4Id;            ///< engine ID of Geant4
     Int_t                     fFastSimId;       ///< Id of registered fast sim
-    std::vector<Int_t>        mNElectrons;      ///< Count number of electrons
-    std::vector<Int_t>        mNPositrons;      ///< Count number of electrons
-    std::vector<Int_t>        mNPhotons;      ///< Count number of electrons
-    std::unordered_map<int, int> mStepsPerPdg;
-    std::unordered_map<int, int> mBoundaryParticlesPerPdg;
+    std::vector<VolumeRoute>  fVolumeRoutes;    //!< Stepping actions indexed by volume Id
+    VolumeRoute               fDefaultRoute;    //!< Route of volumes not in fVolumeRoutes
+    std::vector<TransferRule> fTransferRules;   //!< Rules of all routes, contiguous per volume
+    std::vector<RoutingEntry> fRoutingMap;      ///< Volume to engine routing of the split simulation
+    std::vector<KillThreshold> fKillThresholds; ///< Thresholds of the secondaries not tracked
+    FastShowerMCApplication*  fMasterApplication; //!< Master to merge into (on workers)
+    FastShowerLibrary*        fShowerLibrary;   //!< Library showers are recorded into (not owned)
+    FastShowerTimer*          fTimer;           //!< Timing of the callbacks, 0 if not timed
+    Double_t                  fTransferThreshold; ///< Tracks below this kinetic energy stay in their engine (GeV)
+    Int_t                     fTransfersInEvent; ///< Number of track transfers in the current event
+    std::vector<FastShowerAccumulator> fAccumulators; //!< Accumulators of the histograms filled per step/track
+    FastShowerEventTree*      fEventTree;       //!< Per-event output or input, 0 if none (on master)
+    FastShowerEventWriter*    fEventWriter;     //!< Fills fEventTree asynchronously (on master)
+    std::string               fGeometryCacheDir; ///< Directory of the geometry cache, empty if off
+    Int_t                     fRunEvents;       ///< Number of events of the last RunMC()
+    Double_t                  fRunRealTime;     ///< Real time of the last RunMC() (s)
+    FastShowerEventData       fEventData;       //!< Data of the current event
+    std::vector<Int_t>        fMultiplicityPdgs; ///< Species whose multiplicity per event is counted
+    std::vector<std::vector<Int_t>> mNParticles; ///< Multiplicity distributions, parallel to fMultiplicityPdgs
+    FastShowerPdgCounter mStepsPerPdg;
+    FastShowerPdgCounter mBoundaryParticlesPerPdg;
+    FastShowerPdgCounter mTransfersPerPdg;
+    std::vector<int> mTransfersPerEventVec;
     // All steps
     TH1D mStepsX;
     TH1D mStepsY;
@@ -142,6 +278,12 @@ class FastShowerMCApplication : public TVirtualMCApplication
     /// engines vs volume
     TH2D mEngineVsVolume;
 
+    /// Track transfers from engine (x) to engine (y), the diagonal counts
+    /// the tracks kept below the transfer threshold
+    TH2D mTransfersPerEngine;
+    /// Time spent in the track transfers (s)
+    TH2D mTransferTime;
+
     /// Particles on boundary
     Bool_t fLeft;
     /// Store the proton energy when it leaves the calorimeter
@@ -175,13 +317,46 @@ inline void  FastShowerMCApplication::SetPrintModulo(Int_t value)
 /// Set verbosity
 /// \param verboseLevel  The new verbose level value
 inline void  FastShowerMCApplication::SetVerboseLevel(Int_t verboseLevel)
-{ fVerbose.SetLevel(verboseLevel); }
+{ fVerbose.SetLevel(verboseLevel); SelectStepping(); }
+
+/// Set what is recorded per step; without monitoring and verbosity the
+/// histograms, counters and event summaries filled in Stepping() and
+/// PreTrack() stay empty.
+/// Must be called before InitMC() to be propagated to the workers.
+/// \param level  The monitoring level
+inline void  FastShowerMCApplication::SetMonitoringLevel(EMonitoring level)
+{ fMonitoringLevel = level; SelectStepping(); }
 
 // Set magnetic field
 // \param bz  The new field value in z
 inline void  FastShowerMCApplication::SetField(Double_t bz)
 { fMagField->SetFieldValue(0., 0., bz); }
 
+/// Set the number of events simulated before, e.g. by other processes
+/// \param offset  The number the event counter starts from
+inline void  FastShowerMCApplication::SetEventOffset(Int_t offset)
+{ fEventNo = offset; fNextEventNo = offset; }
+
+/// \return The callback timer, 0 if timing is off
+inline FastShowerTimer* FastShowerMCApplication::GetTimer() const
+{ return fTimer; }
+
+/// Keep tracks below a kinetic energy in the current engine instead of
+/// transferring them in the split simulation
+/// \param kinEnergy  The kinetic energy threshold (GeV), 0 transfers all tracks
+inline void  FastShowerMCApplication::SetTransferThreshold(Double_t kinEnergy)
+{ fTransferThreshold = kinEnergy; }
+
+/// Pre-allocate the stack for a number of tracks per event.
+/// Must be called before InitMC() to be propagated to the workers.
+/// \param capacity  The number of tracks
+inline void  FastShowerMCApplication::SetStackCapacity(Int_t capacity)
+{ fStack->Reserve(capacity); }
+
+/// \return The real time of the last RunMC() (s)
+inline Double_t FastShowerMCApplication::GetRunRealTime() const
+{ return fRunRealTime; }
+
 /// \return The detector construction
 inline FastShowerDetectorConstruction* FastShowerMCApplication::GetDetectorConstruction() const
 { return fDetConstruction; }
@@ -199,6 +374,32 @@ inline FastShowerPrimaryGenerator* FastShowerMCApplication::GetPrimaryGenerator(
 inline void FastShowerMCApplication::SetOldGeometry(Bool_t oldGeometry)
 { fOldGeometry = oldGeometry; }
 
+/// \return The route for the given volume
+/// \param volId  The volume Id
+inline const FastShowerMCApplication::VolumeRoute&
+FastShowerMCApplication::GetVolumeRoute(Int_t volId) const
+{
+  return (volId > 0 && volId < static_cast<Int_t>(fVolumeRoutes.size())) ?
+         fVolumeRoutes[volId] : fDefaultRoute;
+}
+
+/// \return The target engine ID of a track in a volume, -1 if the track
+///         is not transferred
+/// \param route      The route of the volume
+/// \param pdg        The PDG code of the track
+/// \param kinEnergy  The kinetic energy of the track (GeV)
+inline Int_t FastShowerMCApplication::GetTransferTarget(const VolumeRoute& route,
+                                                        Int_t pdg, Double_t kinEnergy) const
+{
+  for(Int_t i = route.fFirstRule; i < route.fFirstRule + route.fNofRules; i++) {
+    const TransferRule& rule = fTransferRules[i];
+    if((rule.fPdg == 0 || rule.fPdg == pdg) && kinEnergy < rule.fMaxKinEnergy) {
+      return rule.fTargetEngineId;
+    }
+  }
+  return -1;
+}
+
 /// Switch on/off special process controls
 /// \param isControls  If true, special process controls setting is activated
 inline void FastShowerMCApplication::SetControls(Bool_t isControls)
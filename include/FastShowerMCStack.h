@@ -19,10 +19,14 @@
 
 #include <TVirtualMCStack.h>
 
-#include <stack>
+#include <functional>
+#include <vector>
+#include <utility>
+#include <unordered_map>
 
 class TParticle;
 class TClonesArray;
+class FastShowerParticleStore;
 
 /// \ingroup EME
 /// \brief Implementation of the TVirtualMCStack interface
@@ -33,7 +37,22 @@ class TClonesArray;
 class FastShowerMCStack : public TVirtualMCStack
 {
   public:
-    FastShowerMCStack(Int_t size);
+    /// Available particle storage backends
+    enum EStorage {
+      kClonesArray,    ///< TParticle objects in a TClonesArray
+      kStructOfArrays  ///< contiguous per-property arrays (FastShowerParticleStore)
+    };
+
+    /// Order in which PopNextTrack() returns the tracks to be done
+    enum EOrdering {
+      kLifo,           ///< last pushed first (depth-first)
+      kEnergyOrdered,  ///< highest total energy first
+      kPerSpecies      ///< one species after the other, last pushed first within a species
+    };
+
+  public:
+    FastShowerMCStack(Int_t size, EStorage storage = kClonesArray,
+                      EOrdering ordering = kLifo);
     FastShowerMCStack();
     virtual ~FastShowerMCStack();
 
@@ -48,6 +67,14 @@ class FastShowerMCStack : public TVirtualMCStack
     virtual TParticle* PopPrimaryForTracking(Int_t i);
     virtual void Print(Option_t* option = "") const;
     void Reset();
+    void Reserve(Int_t size);
+    void ResetStatistics();
+    void MergeStatistics(const FastShowerMCStack& other);
+    void PrintStatistics() const;
+    void SetKillThreshold(Int_t mediumId, Int_t pdg, Double_t kinEnergy,
+                          Double_t survivalProbability = 0.);
+    void CopyKillThresholds(const FastShowerMCStack& other);
+    void SetLocalDepositFunction(std::function<void(Double_t)> localDeposit);
 
     // set methods
     virtual void  SetCurrentTrack(Int_t track);
@@ -62,12 +89,80 @@ class FastShowerMCStack : public TVirtualMCStack
 
     Int_t GetNumberOfParticles(Int_t pdg) const;
 
+    /// \return The number of particles pushed in this event per PDG code;
+    ///         species seen in earlier events are kept with count 0
+    const std::unordered_map<Int_t, Int_t>& GetParticleCounts() const { return fPdgCounts; }
+
+    /// \return The particle storage backend
+    EStorage GetStorage() const { return fStorage; }
+
+    /// \return The track ordering policy
+    EOrdering GetOrdering() const { return fOrdering; }
+
+    /// \return The number of particles the storage holds without allocating
+    Int_t    GetCapacity() const { return fCapacity; }
+
+    /// \return The maximum number of tracks of an event since ResetStatistics()
+    Int_t    GetMaxNtrack() const { return fMaxNtrack; }
+
+    /// \return The number of particles which exceeded the capacity per event
+    Double_t GetAllocationsPerEvent() const
+    { return fNbOfEvents > 0 ? static_cast<Double_t>(fNbOfAllocations) / fNbOfEvents : 0.; }
+
   private:
+    /// Threshold below which the pushed secondaries of a species are not
+    /// tracked
+    struct KillThreshold {
+      Int_t    fPdg;       ///< PDG code
+      Double_t fKinEnergy; ///< Kinetic energy threshold (GeV)
+      Double_t fSurvival;  ///< Survival probability of the Russian roulette, 0 for a local deposit
+    };
+
+    /// Secondaries not tracked per species
+    struct KillCount {
+      Long64_t fKilled;    ///< Number of secondaries not tracked
+      Long64_t fSurvived;  ///< Number of secondaries which survived the Russian roulette
+      Double_t fDeposited; ///< Kinetic energy deposited locally (GeV)
+    };
+
+    /// Tracks to be done of one species (kPerSpecies)
+    struct SpeciesQueue {
+      Int_t              fPdg;    ///< PDG code
+      std::vector<Int_t> fTracks; ///< Track numbers
+    };
+
+    // methods
+    Bool_t KillSecondary(Int_t pdg, Double_t px, Double_t py, Double_t pz,
+                         Double_t e, Double_t& weight);
+    Double_t GetParticleWeight(Int_t track) const;
+    void  PushPending(Int_t track, Int_t pdg, Double_t e);
+    Int_t PopPending();
+    void  PushTrackToStore(Int_t toBeDone, Int_t parent, Int_t pdg,
+  	              Double_t px, Double_t py, Double_t pz, Double_t e,
+  		      Double_t vx, Double_t vy, Double_t vz, Double_t tof,
+		      Double_t polx, Double_t poly, Double_t polz,
+		      TMCProcess mech, Int_t& ntr, Double_t weight,
+		      Int_t is);
+
     // data members
-    std::stack<TParticle*>  fStack;       //!< The stack of particles (transient)
+    EStorage                fStorage;     //!< The particle storage backend
+    EOrdering               fOrdering;    //!< The track ordering policy
     TClonesArray*           fParticles;   ///< The array of particle (persistent)
+    FastShowerParticleStore* fStore;      //!< The particle arrays (kStructOfArrays)
+    std::vector<Int_t>      fTrackStack;  //!< The stack of track numbers to be done (kLifo)
+    std::vector<std::pair<Double_t, Int_t>> fEnergyHeap; //!< Heap of (energy, track number) to be done (kEnergyOrdered)
+    std::vector<SpeciesQueue> fSpeciesQueues; //!< Track numbers to be done per species (kPerSpecies)
+    Int_t                   fCurrentQueue;//!< The queue drained last (kPerSpecies)
+    std::unordered_map<Int_t, Int_t> fPdgCounts; //!< Number of pushed particles per PDG code
     Int_t                   fCurrentTrack;///< The current track number
     Int_t                   fNPrimary;    ///< The number of primaries
+    Int_t                   fCapacity;    //!< Number of particles the storage holds without allocating
+    Int_t                   fMaxNtrack;   //!< Maximum number of tracks of an event
+    Long64_t                fNbOfEvents;  //!< Number of events reset
+    Long64_t                fNbOfAllocations; //!< Number of particles which exceeded the capacity
+    std::vector<std::vector<KillThreshold>> fKillThresholds; //!< Thresholds indexed by medium ID
+    std::unordered_map<Int_t, KillCount> fKillCounts; //!< Secondaries not tracked per PDG code
+    std::function<void(Double_t)> fLocalDeposit; //!< Deposits the energy of killed secondaries
 
     ClassDef(FastShowerMCStack,1) // FastShowerMCStack
 };
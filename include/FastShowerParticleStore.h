@@ -0,0 +1,86 @@
+#ifndef EXME_PARTICLE_STORE_H
+#define EXME_PARTICLE_STORE_H
+
+/// \file FastShowerParticleStore.h
+/// \brief Definition of the FastShowerParticleStore class
+///
+/// Structure-of-arrays storage of the particles pushed to the stack
+
+#include <vector>
+
+#include <Rtypes.h>
+#include <TMCProcess.h>
+
+class TParticle;
+
+/// \ingroup EME
+/// \brief Particle store keeping each particle property in its own
+/// contiguous array
+///
+/// The arrays keep their capacity when the store is cleared so that they are
+/// reused from one event to the next. TParticle objects are only materialised
+/// when a particle is requested via GetParticle(). They are owned by the store,
+/// their addresses stay valid until the store is cleared and they are recycled
+/// in the following events.
+
+class FastShowerParticleStore
+{
+  public:
+    FastShowerParticleStore();
+    ~FastShowerParticleStore();
+
+    // methods
+    Int_t Add(Int_t pdg, Int_t status, Int_t parent,
+              Double_t px, Double_t py, Double_t pz, Double_t e,
+              Double_t vx, Double_t vy, Double_t vz, Double_t tof,
+              Double_t polx, Double_t poly, Double_t polz,
+              TMCProcess mech, Double_t weight);
+    void  Clear();
+    void  Reserve(Int_t size);
+
+    // get methods
+    TParticle* GetParticle(Int_t id) const;
+
+    /// \return The number of stored particles
+    Int_t    GetSize() const          { return static_cast<Int_t>(fPdg.size()); }
+    /// \return The number of particles which can be stored without reallocation
+    Int_t    GetCapacity() const      { return static_cast<Int_t>(fPdg.capacity()); }
+    /// \return The PDG code of particle \em id
+    Int_t    GetPdg(Int_t id) const    { return fPdg[id]; }
+    /// \return The parent track number of particle \em id
+    Int_t    GetParent(Int_t id) const { return fParent[id]; }
+    /// \return The total energy of particle \em id
+    Double_t GetEnergy(Int_t id) const { return fE[id]; }
+    /// \return The weight of particle \em id
+    Double_t GetWeight(Int_t id) const { return fWeight[id]; }
+    /// \return The PDG codes of all particles
+    const std::vector<Int_t>& GetPdgs() const { return fPdg; }
+
+  private:
+    FastShowerParticleStore(const FastShowerParticleStore&);
+    FastShowerParticleStore& operator=(const FastShowerParticleStore&);
+
+    // data members
+    std::vector<Int_t>    fPdg;     ///< PDG codes
+    std::vector<Int_t>    fStatus;  ///< Generation status codes
+    std::vector<Int_t>    fParent;  ///< Parent track numbers
+    std::vector<UInt_t>   fProcess; ///< Creator process VMC codes
+    std::vector<Double_t> fPx;      ///< Momentum x components
+    std::vector<Double_t> fPy;      ///< Momentum y components
+    std::vector<Double_t> fPz;      ///< Momentum z components
+    std::vector<Double_t> fE;       ///< Total energies
+    std::vector<Double_t> fVx;      ///< Vertex x components
+    std::vector<Double_t> fVy;      ///< Vertex y components
+    std::vector<Double_t> fVz;      ///< Vertex z components
+    std::vector<Double_t> fTof;     ///< Times of flight
+    std::vector<Double_t> fPolx;    ///< Polarisation x components
+    std::vector<Double_t> fPoly;    ///< Polarisation y components
+    std::vector<Double_t> fPolz;    ///< Polarisation z components
+    std::vector<Double_t> fWeight;  ///< Weights
+
+    mutable std::vector<TParticle*> fViews;      ///< Materialised particles (recycled)
+    mutable std::vector<UInt_t>     fViewEvent;  ///< Clear() cycle a view was filled in
+    UInt_t                          fEvent;      ///< Counts the calls to Clear()
+};
+
+#endif //EXME_PARTICLE_STORE_H
@@ -0,0 +1,68 @@
+#ifndef EXME_PDG_COUNTER_H
+#define EXME_PDG_COUNTER_H
+
+/// \file FastShowerPdgCounter.h
+/// \brief Definition of the FastShowerPdgCounter class
+///
+/// Counting per particle species with a dense PDG index
+
+#include <unordered_map>
+#include <vector>
+
+#include <Rtypes.h>
+
+class TH1;
+
+/// \ingroup EME
+/// \brief Counts entries per PDG code in a flat array
+///
+/// PDG codes up to kMaxDirectPdg in absolute value are mapped to a dense
+/// slot via a lookup table; the common shower species get their slots at
+/// construction, others when they are first seen. Fill() is then a table
+/// lookup and the increment of a plain array instead of a hash map access.
+/// Codes outside the table (nuclei, excited states) fall back to a hash map.
+
+class FastShowerPdgCounter
+{
+  public:
+    FastShowerPdgCounter();
+
+    // methods
+    void  Add(const FastShowerPdgCounter& other);
+    void  Add(const TH1& histo);
+    void  AddTo(std::unordered_map<Int_t, Long64_t>& counts, Int_t maxPdg = 0) const;
+    void  FillHistogram(TH1& histo, Int_t maxPdg = 0) const;
+    void  Reset();
+
+    /// Add an entry
+    /// \param pdg  The PDG code
+    void  Fill(Int_t pdg)
+    {
+      if (pdg >= -kMaxDirectPdg && pdg <= kMaxDirectPdg) {
+        Int_t slot = fSlots[pdg + kMaxDirectPdg];
+        if (slot < 0) slot = AddSlot(pdg);
+        fCounts[slot]++;
+      } else {
+        fRareCounts[pdg]++;
+      }
+    }
+
+    // get methods
+    Long64_t GetCount(Int_t pdg) const;
+    Long64_t GetTotal() const;
+
+    /// Largest absolute PDG code with a dense slot
+    static const Int_t kMaxDirectPdg = 5000;
+
+  private:
+    Int_t  AddSlot(Int_t pdg);
+    void   Add(Int_t pdg, Long64_t count);
+
+    // data members
+    std::vector<Int_t>    fSlots;  ///< Dense slot per PDG code + kMaxDirectPdg, -1 if none
+    std::vector<Int_t>    fPdgs;   ///< PDG code of each slot
+    std::vector<Long64_t> fCounts; ///< Count of each slot
+    std::unordered_map<Int_t, Long64_t> fRareCounts; ///< Counts of the codes without slot
+};
+
+#endif //EXME_PDG_COUNTER_H
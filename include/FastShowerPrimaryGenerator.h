@@ -19,6 +19,13 @@
 ///
 /// \author I. Hrivnacova; IPN, Orsay
 
+#include <vector>
+
+#include <TObject.h>
+
+#include "FastShowerSampler.h"
+
+class TH1;
 class TVirtualMCStack;
 class TVector3;
 
@@ -57,17 +64,22 @@ class FastShowerPrimaryGenerator : public TObject
     void  SetPrimaryType(Type primaryType);
     void  SetNofPrimaries(Int_t nofPrimaries);
     void  SetPrimaryParticleEnergy(Double_t e);
+    Bool_t SetFlatSpectrum(Double_t minEnergy, Double_t maxEnergy);
+    Bool_t SetPowerLawSpectrum(Double_t minEnergy, Double_t maxEnergy,
+                               Double_t index, Int_t nofBins = 1000);
+    Bool_t SetHistogramSpectrum(const TH1& histo);
+    void  SetAngularSpread(Double_t maxTheta);
 
     // get methods
     Bool_t GetUserDecay() const;
 
   private:
     // methods
-    void GeneratePrimary1(const TVector3& origin);
+    void GeneratePrimaryBatch(Int_t pdg, Double_t mass, Double_t kinEnergy,
+                              const TVector3& origin, Int_t nofPrimaries,
+                              const FastShowerSampler* spectrum = 0);
     void GeneratePrimary2(const TVector3& origin);
-    void GeneratePrimary3(const TVector3& origin);
     void GeneratePrimary4(const TVector3& origin);
-    void GeneratePrimary5(const TVector3& origin);
 
     // data members
     TVirtualMCStack*  fStack;         ///< VMC stack
@@ -75,6 +87,16 @@ class FastShowerPrimaryGenerator : public TObject
     Type              fPrimaryType;   ///< Primary generator selection
     Int_t             fNofPrimaries;  ///< Number of primary particles
     Double_t          fPrimaryParticleEnergy; ///< Energy of primaries
+    Double_t          fProtonMass;    //!< Proton mass, looked up once at construction
+    FastShowerSampler fSpectrum;      //!< Kinetic energy spectrum of the default primaries
+    Double_t          fCosThetaMax;   //!< Cosine of the maximal angle to the beam axis
+    std::vector<Double_t> fRandoms;   //!< Random numbers of a batch
+    std::vector<Double_t> fVy;        //!< Vertex y of a batch
+    std::vector<Double_t> fVz;        //!< Vertex z of a batch
+    std::vector<Double_t> fE;         //!< Total energy of a batch
+    std::vector<Double_t> fPx;        //!< Momentum x of a batch
+    std::vector<Double_t> fPy;        //!< Momentum y of a batch
+    std::vector<Double_t> fPz;        //!< Momentum z of a batch
 
   ClassDef(FastShowerPrimaryGenerator,1)  //FastShowerPrimaryGenerator
 };
@@ -97,6 +119,8 @@ inline void  FastShowerPrimaryGenerator::SetPrimaryType(
 inline void  FastShowerPrimaryGenerator::SetNofPrimaries(Int_t nofPrimaries)
 { fNofPrimaries = nofPrimaries; }
 
+/// Set the kinetic energy of the mono-energetic primaries
+/// \param e  The kinetic energy (in GeV)
 inline void  FastShowerPrimaryGenerator::SetPrimaryParticleEnergy(Double_t e)
 { fPrimaryParticleEnergy = e; }
 
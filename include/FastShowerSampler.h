@@ -0,0 +1,134 @@
+#ifndef EXME_SAMPLER_H
+#define EXME_SAMPLER_H
+
+/// \file FastShowerSampler.h
+/// \brief Definition of the FastShowerSampler class
+///
+/// Table-driven sampling of a binned distribution
+
+#include <vector>
+
+#include <TH1.h>
+
+/// \ingroup EME
+/// \brief Samples values distributed like the content of a 1D histogram
+///
+/// A bin is selected in constant time with Walker's alias method, the value
+/// is then drawn uniformly within the bin. The tables are contiguous arrays
+/// of the size of the number of bins, so that they stay cache-resident
+/// when sampling in the fast simulation hot path.
+
+class FastShowerSampler
+{
+  public:
+    FastShowerSampler() = default;
+
+    /// Build the tables from the bin contents of a histogram; negative
+    /// contents and under-/overflow are ignored
+    /// \return       False if the histogram has no positive content
+    /// \param histo  The histogram
+    bool Build(const TH1& histo)
+    {
+      int nofBins = histo.GetNbinsX();
+      std::vector<double> edges(nofBins + 1);
+      std::vector<double> weights(nofBins);
+      for(int i = 0; i < nofBins; i++) {
+        edges[i] = histo.GetXaxis()->GetBinLowEdge(i+1);
+        weights[i] = histo.GetBinContent(i+1);
+      }
+      edges[nofBins] = histo.GetXaxis()->GetBinUpEdge(nofBins);
+      return Build(edges, weights);
+    }
+
+    /// Build the tables from binned weights; negative weights are ignored
+    /// \return         False if there is no positive weight
+    /// \param edges    The bin edges, one more than weights
+    /// \param weights  The weight of each bin
+    bool Build(const std::vector<double>& edges, const std::vector<double>& weights)
+    {
+      int nofBins = weights.size();
+      mLowEdges.resize(nofBins);
+      mWidths.resize(nofBins);
+      mProbabilities.resize(nofBins);
+      mAliases.resize(nofBins);
+
+      double sum = 0.;
+      for(int i = 0; i < nofBins; i++) {
+        mLowEdges[i] = edges[i];
+        mWidths[i] = edges[i+1] - edges[i];
+        mProbabilities[i] = weights[i] > 0. ? weights[i] : 0.;
+        sum += mProbabilities[i];
+      }
+      if(sum <= 0.) {
+        Clear();
+        return false;
+      }
+
+      // Vose's variant: split bins into those below and above the average
+      std::vector<int> small;
+      std::vector<int> large;
+      for(int i = 0; i < nofBins; i++) {
+        mProbabilities[i] *= nofBins / sum;
+        mAliases[i] = i;
+        (mProbabilities[i] < 1. ? small : large).push_back(i);
+      }
+      while(!small.empty() && !large.empty()) {
+        int s = small.back();
+        int l = large.back();
+        small.pop_back();
+        mAliases[s] = l;
+        mProbabilities[l] -= 1. - mProbabilities[s];
+        if(mProbabilities[l] < 1.) {
+          large.pop_back();
+          small.push_back(l);
+        }
+      }
+      // Remaining bins are full up to rounding
+      for(int i : large) mProbabilities[i] = 1.;
+      for(int i : small) mProbabilities[i] = 1.;
+      return true;
+    }
+
+    /// \return    A sampled value
+    /// \param u1  A random number uniform in [0, 1) selecting the bin
+    /// \param u2  A random number uniform in [0, 1) for the position in the bin
+    double Sample(double u1, double u2) const
+    {
+      double x = u1 * mProbabilities.size();
+      std::size_t bin = static_cast<std::size_t>(x);
+      if(bin >= mProbabilities.size()) {
+        bin = mProbabilities.size() - 1;
+      }
+      if(x - bin >= mProbabilities[bin]) {
+        bin = mAliases[bin];
+      }
+      return mLowEdges[bin] + u2 * mWidths[bin];
+    }
+
+    /// Remove the tables
+    void Clear()
+    {
+      mLowEdges.clear();
+      mWidths.clear();
+      mProbabilities.clear();
+      mAliases.clear();
+    }
+
+    /// \return True if no tables are built
+    bool IsEmpty() const
+    {
+      return mProbabilities.empty();
+    }
+
+  private:
+    /// Lower edges of the bins
+    std::vector<double> mLowEdges;
+    /// Widths of the bins
+    std::vector<double> mWidths;
+    /// Probability to keep a selected bin instead of taking its alias
+    std::vector<double> mProbabilities;
+    /// Alias of each bin
+    std::vector<int> mAliases;
+};
+
+#endif //EXME_SAMPLER_H
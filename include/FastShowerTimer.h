@@ -0,0 +1,102 @@
+#ifndef EXME_TIMER_H
+#define EXME_TIMER_H
+
+/// \file FastShowerTimer.h
+/// \brief Definition of the FastShowerTimer class
+///
+/// Timing of the user callbacks per engine
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <Rtypes.h>
+
+class TH1;
+class TH2D;
+
+/// \ingroup EME
+/// \brief Accumulates the number of calls and the time spent in the user
+/// callbacks of the MC application, separately for each engine
+///
+/// Times are taken with std::chrono::steady_clock and are inclusive, i.e.
+/// Stepping contains ProcessHits and TransferTrack.
+
+class FastShowerTimer
+{
+  public:
+    /// The timed callbacks
+    enum ECallback {
+      kGeneratePrimaries,
+      kBeginEvent,
+      kPreTrack,
+      kStepping,
+      kPostTrack,
+      kFinishEvent,
+      kProcessHits,
+      kTransferTrack,
+      kNofCallbacks
+    };
+
+    /// The clock used for the samples
+    typedef std::chrono::steady_clock Clock;
+
+    /// Times the enclosing scope; does nothing if no timer is given so that
+    /// it can stay in place when timing is switched off
+    class Guard
+    {
+      public:
+        Guard(FastShowerTimer* timer, Int_t engineId, ECallback callback)
+          : fTimer(timer), fEngineId(engineId), fCallback(callback)
+        { if (fTimer) fStart = Clock::now(); }
+        ~Guard()
+        { if (fTimer) fTimer->Add(fEngineId, fCallback, Clock::now() - fStart); }
+
+      private:
+        Guard(const Guard&);
+        Guard& operator=(const Guard&);
+
+        FastShowerTimer*   fTimer;    ///< The timer, 0 if timing is off
+        Int_t              fEngineId; ///< The engine ID
+        ECallback          fCallback; ///< The timed callback
+        Clock::time_point  fStart;    ///< The start of the scope
+    };
+
+  public:
+    FastShowerTimer();
+
+    // static methods
+    static const char* GetCallbackName(ECallback callback);
+
+    // methods
+    void  Add(Int_t engineId, ECallback callback, Clock::duration duration);
+    void  Add(const FastShowerTimer& other);
+    void  AddHistograms(const TH1& times, const TH1& calls);
+    void  FillHistograms(TH2D& times, TH2D& calls) const;
+    void  Print() const;
+
+    // set methods
+    void  SetEngineName(Int_t engineId, const char* name);
+
+    // get methods
+    Int_t GetNbOfEngines() const;
+
+  private:
+    /// Calls and time of one callback of one engine
+    struct Counter {
+      Long64_t fCalls;       ///< Number of calls
+      Long64_t fNanoseconds; ///< Accumulated time
+    };
+
+    void  Resize(Int_t nofEngines);
+
+    // data members
+    std::vector<Counter>     fCounters;    ///< Counters indexed by (engine, callback)
+    std::vector<std::string> fEngineNames; ///< Engine names indexed by engine ID
+};
+
+/// \return The number of engines with counters
+inline Int_t FastShowerTimer::GetNbOfEngines() const
+{ return fEngineNames.size(); }
+
+#endif //EXME_TIMER_H
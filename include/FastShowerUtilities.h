@@ -19,6 +19,17 @@ namespace utilities
     v[bin] += weight;
   }
 
+  template <typename T>
+  void addVectors(std::vector<T>& to, const std::vector<T>& from)
+  {
+    if(from.size() > to.size()) {
+      to.resize(from.size(), T(0));
+    }
+    for(std::size_t i = 0; i < from.size(); i++) {
+      to[i] += from[i];
+    }
+  }
+
   template <typename T, typename H>
   void vectorToHistogram(const std::vector<T> v, H& histo)
   {
@@ -39,6 +50,17 @@ namespace utilities
     histo.SetEntries(sum);
   }
 
+  template <typename T, typename H>
+  void histogramToVector(const H& histo, std::vector<T>& v)
+  {
+    for(int i = 0; i < histo.GetNbinsX(); i++) {
+      T content = static_cast<T>(histo.GetBinContent(i+1));
+      if(content != T(0)) {
+        insertIntoVector(v, i, content);
+      }
+    }
+  }
+
   template <typename K, typename V, typename H>
   void mapToHistogram(const std::unordered_map<K,V> m, H& histo)
   {
@@ -0,0 +1,75 @@
+/// \file FastShowerAccumulator.cxx
+/// \brief Implementation of the FastShowerAccumulator class
+
+#include <TH1.h>
+
+#include "FastShowerAccumulator.h"
+
+//_____________________________________________________________________________
+FastShowerAccumulator::FastShowerAccumulator()
+  : fNbins(0),
+    fXmin(0.),
+    fXmax(0.),
+    fInvBinWidth(0.),
+    fEntries(0.),
+    fSumW(0.),
+    fSumWX(0.),
+    fSumWX2(0.),
+    fContents()
+{
+/// Default constructor
+}
+
+//_____________________________________________________________________________
+void FastShowerAccumulator::Init(const TH1& histo)
+{
+/// Take over the binning of a histogram with equidistant bins
+/// and reset the accumulated entries.
+/// \param histo  The histogram
+
+  fNbins = histo.GetXaxis()->GetNbins();
+  fXmin = histo.GetXaxis()->GetXmin();
+  fXmax = histo.GetXaxis()->GetXmax();
+  fInvBinWidth = fNbins / (fXmax - fXmin);
+  fContents.assign(fNbins + 2, 0.);
+  Reset();
+}
+
+//_____________________________________________________________________________
+void FastShowerAccumulator::Flush(TH1& histo)
+{
+/// Add the accumulated entries to the histogram and reset them.
+/// \param histo  The histogram, with the binning given in Init()
+
+  if (fEntries == 0.) return;
+
+  // Statistics as TH1::Fill() would have accumulated them
+  Double_t stats[4];
+  histo.GetStats(stats);
+  stats[0] += fSumW;
+  stats[1] += fSumW;   // unit weights, sum of w^2 equals sum of w
+  stats[2] += fSumWX;
+  stats[3] += fSumWX2;
+  Double_t entries = histo.GetEntries() + fEntries;
+
+  for (Int_t bin=0; bin<fNbins+2; bin++) {
+    if (fContents[bin] != 0.) histo.AddBinContent(bin, fContents[bin]);
+  }
+
+  histo.PutStats(stats);
+  histo.SetEntries(entries);
+
+  Reset();
+}
+
+//_____________________________________________________________________________
+void FastShowerAccumulator::Reset()
+{
+/// Reset the accumulated entries, the binning is kept.
+
+  for (Double_t& content : fContents) content = 0.;
+  fEntries = 0.;
+  fSumW = 0.;
+  fSumWX = 0.;
+  fSumWX2 = 0.;
+}
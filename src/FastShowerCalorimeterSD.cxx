@@ -19,7 +19,6 @@
 
 #include "FastShowerCalorimeterSD.h"
 #include "FastShowerDetectorConstruction.h"
-#include "FastShowerCalorHit.h"
 
 #include <Riostream.h>
 #include <TVirtualMC.h>
@@ -39,22 +38,28 @@ FastShowerCalorimeterSD::FastShowerCalorimeterSD(const char* name,
   : TNamed(name, ""),
     fMC(0),
     fDetector(detector),
-    fCalCollection(0),
     fAbsorberVolId(0),
     fGapVolId(0),
     fVerboseLevel(1),
-    fTotEGap(0.)
+    fTotEGap(0.),
+    fTrackWeight(1.),
+    fNbOfLayers(0),
+    fNbOfCellsY(1),
+    fNbOfCellsZ(1),
+    fInvCellSizeY(0.),
+    fInvCellSizeZ(0.),
+    fCells(),
+    fTouchedCells(),
+    fIsTouched()
 {
 /// Standard constructor.
-/// Create hits collection and an empty hit for each layer
+/// Create the cell buffer with one cell per layer.
 /// As the copy numbers may start from 0 or 1 (depending on
 /// geometry model, we create one more layer for this case.)
 /// \param name      The calorimeter hits collection name
 /// \param detector  The detector construction
 
-  fCalCollection = new TClonesArray("FastShowerCalorHit", 500);
-  for (Int_t i=0; i<fDetector->GetNbOfLayers()+1; i++)
-    new ((*fCalCollection)[i]) FastShowerCalorHit();
+  AllocateCells();
 }
 
 //_____________________________________________________________________________
@@ -63,33 +68,45 @@ FastShowerCalorimeterSD::FastShowerCalorimeterSD(const FastShowerCalorimeterSD&
   : TNamed(origin),
     fMC(0),
     fDetector(detector),
-    fCalCollection(0),
     fAbsorberVolId(origin.fAbsorberVolId),
     fGapVolId(origin.fGapVolId),
     fVerboseLevel(origin.fVerboseLevel),
-    fTotEGap(origin.fTotEGap)
+    fTotEGap(origin.fTotEGap),
+    fTrackWeight(1.),
+    fNbOfLayers(0),
+    fNbOfCellsY(origin.fNbOfCellsY),
+    fNbOfCellsZ(origin.fNbOfCellsZ),
+    fInvCellSizeY(origin.fInvCellSizeY),
+    fInvCellSizeZ(origin.fInvCellSizeZ),
+    fCells(),
+    fTouchedCells(),
+    fIsTouched()
 {
 /// Copy constructor (for clonig on worker thread in MT mode).
-/// Create hits collection and an empty hit for each layer
-/// As the copy numbers may start from 0 or 1 (depending on
-/// geometry model, we create one more layer for this case.)
+/// Create the cell buffer with the segmentation of the origin.
 /// \param origin    The source object (on master).
 /// \param detector  The detector construction
 
-  fCalCollection = new TClonesArray("FastShowerCalorHit", 500);
-  for (Int_t i=0; i<fDetector->GetNbOfLayers()+1; i++)
-    new ((*fCalCollection)[i]) FastShowerCalorHit();
+  AllocateCells();
 }
 
 //_____________________________________________________________________________
 FastShowerCalorimeterSD::FastShowerCalorimeterSD()
   : TNamed(),
     fDetector(0),
-    fCalCollection(0),
     fAbsorberVolId(0),
     fGapVolId(0),
     fVerboseLevel(1),
-    fTotEGap(0.)
+    fTotEGap(0.),
+    fTrackWeight(1.),
+    fNbOfLayers(0),
+    fNbOfCellsY(1),
+    fNbOfCellsZ(1),
+    fInvCellSizeY(0.),
+    fInvCellSizeZ(0.),
+    fCells(),
+    fTouchedCells(),
+    fIsTouched()
 {
 /// Default constructor
 }
@@ -98,9 +115,6 @@ FastShowerCalorimeterSD::FastShowerCalorimeterSD()
 FastShowerCalorimeterSD::~FastShowerCalorimeterSD()
 {
 /// Destructor
-
-  if (fCalCollection) fCalCollection->Delete();
-  delete fCalCollection;
 }
 
 //
@@ -108,27 +122,110 @@ FastShowerCalorimeterSD::~FastShowerCalorimeterSD()
 //
 
 //_____________________________________________________________________________
-FastShowerCalorHit* FastShowerCalorimeterSD::GetHit(Int_t i) const
+void FastShowerCalorimeterSD::AllocateCells()
 {
-/// \return   The hit for the specified layer.
-/// \param i  The layer number
+/// (Re)create the cell buffer for the current number of layers and cells.
 
-  return (FastShowerCalorHit*)fCalCollection->At(i);
+  fNbOfLayers = fDetector->GetNbOfLayers() + 1;
+  Int_t nofCells = fNbOfLayers * GetNbOfCells();
+
+  fCells.assign(nofCells * kNofQuantities, 0.);
+  fIsTouched.assign(nofCells, kFALSE);
+  fTouchedCells.clear();
+  fTouchedCells.reserve(nofCells);
 }
 
 //_____________________________________________________________________________
-void  FastShowerCalorimeterSD::ResetHits()
+Int_t FastShowerCalorimeterSD::GetCellIndex(Double_t y, Double_t z) const
 {
-/// Reset all hits in the hits collection.
+/// \return   The cell number in a layer for the given transverse position;
+///           positions outside the calorimeter are assigned to the edge cells
+/// \param y  The y position
+/// \param z  The z position
+
+  // The calorimeter is centred at y = z = 0
+  Int_t iy = static_cast<Int_t>(y * fInvCellSizeY + 0.5 * fNbOfCellsY);
+  Int_t iz = static_cast<Int_t>(z * fInvCellSizeZ + 0.5 * fNbOfCellsZ);
 
-  for (Int_t i=0; i<fCalCollection->GetEntriesFast(); i++)
-    GetHit(i)->Reset();
+  if (iy < 0) iy = 0;
+  if (iy >= fNbOfCellsY) iy = fNbOfCellsY - 1;
+  if (iz < 0) iz = 0;
+  if (iz >= fNbOfCellsZ) iz = fNbOfCellsZ - 1;
+
+  return iy * fNbOfCellsZ + iz;
+}
+
+//_____________________________________________________________________________
+Bool_t FastShowerCalorimeterSD::AddDeposit(Double_t edep, Double_t step)
+{
+/// Account an energy deposit and a track length in the cell of the current
+/// track position.
+/// \return      False if the current track is not in the calorimeter
+/// \param edep  The energy deposit
+/// \param step  The track length
+
+  Int_t copyNo;
+  Int_t id = fMC->CurrentVolID(copyNo);
+
+  if (id != fAbsorberVolId  &&  id != fGapVolId )
+    return false;
+
+  fMC->CurrentVolOffID(2, copyNo);
+  //cout << "Got copyNo "<< copyNo << " " << fMC->CurrentVolPath() << endl;
+
+  if ( copyNo < 0 || copyNo >= fNbOfLayers ) {
+    std::cerr << "No hit found for layer with copyNo = " << copyNo << endl;
+    return false;
+  }
+
+  Int_t cell = 0;
+  if (fNbOfCellsY * fNbOfCellsZ > 1) {
+    Double_t x, y, z;
+    fMC->TrackPosition(x, y, z);
+    cell = GetCellIndex(y, z);
+  }
+
+  Int_t index = copyNo * GetNbOfCells() + cell;
+  if ( ! fIsTouched[index] ) {
+    fIsTouched[index] = kTRUE;
+    fTouchedCells.push_back(index);
+  }
+
+  Double_t* hit = &fCells[index * kNofQuantities];
+  if (id == fAbsorberVolId) {
+    hit[kEdepAbs] += edep;
+    hit[kTrakAbs] += step;
+  }
+  else {
+    hit[kEdepGap] += edep;
+    hit[kTrakGap] += step;
+  }
+
+  return true;
 }
 
 //
 // public methods
 //
 
+//_____________________________________________________________________________
+void FastShowerCalorimeterSD::SetCellSegmentation(Int_t nofCellsY, Int_t nofCellsZ)
+{
+/// Set the transverse segmentation of the layers; the accounted
+/// quantities are reset.
+/// \param nofCellsY  The number of cells along y
+/// \param nofCellsZ  The number of cells along z
+
+  if (nofCellsY < 1 || nofCellsZ < 1) {
+    Warning("SetCellSegmentation", "Number of cells must be positive, segmentation not changed");
+    return;
+  }
+
+  fNbOfCellsY = nofCellsY;
+  fNbOfCellsZ = nofCellsZ;
+  AllocateCells();
+}
+
 //_____________________________________________________________________________
 void FastShowerCalorimeterSD::Initialize()
 {
@@ -152,41 +249,35 @@ void FastShowerCalorimeterSD::Initialize()
     fAbsorberVolId = fMC->VolId("Abso");
     fGapVolId = fMC->VolId("Gap");
   }
+
+  // The geometry is final now
+  fInvCellSizeY = fNbOfCellsY / fDetector->GetCalorSizeYZ();
+  fInvCellSizeZ = fNbOfCellsZ / fDetector->GetCalorSizeYZ();
+  if (fNbOfLayers != fDetector->GetNbOfLayers() + 1) AllocateCells();
 }
 
 //_____________________________________________________________________________
 Bool_t FastShowerCalorimeterSD::ProcessHits()
 {
-/// Account energy deposit and track lengths for each layer in its hit.
-
-  Int_t copyNo;
-  Int_t id = fMC->CurrentVolID(copyNo);
-
-  if (id != fAbsorberVolId  &&  id != fGapVolId )
-    return false;
-
-  fMC->CurrentVolOffID(2, copyNo);
-  //cout << "Got copyNo "<< copyNo << " " << fMC->CurrentVolPath() << endl;
-
-  Double_t edep = fMC->Edep();
+/// Account energy deposit and track lengths for each cell, weighted with
+/// the weight of the current track set with SetTrackWeight() (not 1 for
+/// Russian roulette survivors).
 
   Double_t step = 0.;
   if (fMC->TrackCharge() != 0.) step = fMC->TrackStep();
 
-  if ( ! GetHit(copyNo) ) {
-    std::cerr << "No hit found for layer with copyNo = " << copyNo << endl;
-    return false;
-  }
-
-  if (id == fAbsorberVolId) {
-    GetHit(copyNo)->AddAbs(edep,step);
-  }
+  return AddDeposit(fMC->Edep() * fTrackWeight, step * fTrackWeight);
+}
 
-  if (id == fGapVolId) {
-    GetHit(copyNo)->AddGap(edep,step);
-  }
+//_____________________________________________________________________________
+Bool_t FastShowerCalorimeterSD::AddLocalDeposit(Double_t edep)
+{
+/// Account an energy deposit at the current track position, e.g. of a
+/// secondary which is not tracked. The deposit is taken as weighted.
+/// \return      False if the current track is not in the calorimeter
+/// \param edep  The energy deposit
 
-  return true;
+  return AddDeposit(edep, 0.);
 }
 
 //_____________________________________________________________________________
@@ -206,6 +297,65 @@ void FastShowerCalorimeterSD::SetTotalEdepGap(Double_t sumGapHits)
   fTotEGap = sumGapHits;
 }
 
+//_____________________________________________________________________________
+void FastShowerCalorimeterSD::AddProfile(const Float_t* profile, Double_t scale)
+{
+/// Add the energy deposits of a whole shower at once, e.g. sampled
+/// from a FastShowerLibrary.
+/// \param profile  The absorber and gap deposits of each (layer, cell),
+///                 profile[2 * (layer * nofCells + cell) + {0, 1}]
+/// \param scale    The factor the deposits are scaled with
+
+  Int_t nofCells = fNbOfLayers * GetNbOfCells();
+  for (Int_t index=0; index<nofCells; index++) {
+    Float_t edepAbs = profile[2 * index];
+    Float_t edepGap = profile[2 * index + 1];
+    if (edepAbs == 0. && edepGap == 0.) continue;
+
+    if ( ! fIsTouched[index] ) {
+      fIsTouched[index] = kTRUE;
+      fTouchedCells.push_back(index);
+    }
+    fCells[index * kNofQuantities + kEdepAbs] += scale * edepAbs;
+    fCells[index * kNofQuantities + kEdepGap] += scale * edepGap;
+  }
+}
+
+//_____________________________________________________________________________
+void FastShowerCalorimeterSD::AddCellValues(Int_t layer, Int_t cell, const Double_t* values)
+{
+/// Add the accounted quantities of one cell, e.g. of a stored event.
+/// \param layer   The layer number
+/// \param cell    The cell number in the layer (iy * nofCellsZ + iz)
+/// \param values  The quantities, indexed by EQuantity
+
+  if (layer < 0 || layer >= fNbOfLayers || cell < 0 || cell >= GetNbOfCells()) {
+    Warning("AddCellValues", "No cell %d in layer %d", cell, layer);
+    return;
+  }
+
+  Int_t index = layer * GetNbOfCells() + cell;
+  if ( ! fIsTouched[index] ) {
+    fIsTouched[index] = kTRUE;
+    fTouchedCells.push_back(index);
+  }
+  for (Int_t i=0; i<kNofQuantities; i++)
+    fCells[index * kNofQuantities + i] += values[i];
+}
+
+//_____________________________________________________________________________
+void  FastShowerCalorimeterSD::ResetHits()
+{
+/// Reset the cells hit in this event.
+
+  for (Int_t index : fTouchedCells) {
+    Double_t* cell = &fCells[index * kNofQuantities];
+    for (Int_t i=0; i<kNofQuantities; i++) cell[i] = 0.;
+    fIsTouched[index] = kFALSE;
+  }
+  fTouchedCells.clear();
+}
+
 //_____________________________________________________________________________
 Double_t FastShowerCalorimeterSD::GetTotalEdepGap() const
 {
@@ -213,8 +363,8 @@ Double_t FastShowerCalorimeterSD::GetTotalEdepGap() const
     return fTotEGap;
   }
   Double_t totEGap=0.;
-  for (Int_t i=0; i<fCalCollection->GetEntriesFast(); i++) {
-    totEGap += GetHit(i)->GetEdepGap();
+  for (Int_t index : fTouchedCells) {
+    totEGap += fCells[index * kNofQuantities + kEdepGap];
   }
   return totEGap;
 }
@@ -222,13 +372,26 @@ Double_t FastShowerCalorimeterSD::GetTotalEdepGap() const
 //_____________________________________________________________________________
 void FastShowerCalorimeterSD::Print(Option_t* /*option*/) const
 {
-/// Print the hits collection.
+/// Print the hits collection, summed over the cells of each layer.
 
-   Int_t nofHits = fCalCollection->GetEntriesFast();
+   std::vector<Double_t> layers(fNbOfLayers * kNofQuantities, 0.);
+   for (Int_t index : fTouchedCells) {
+     Int_t layer = index / GetNbOfCells();
+     for (Int_t i=0; i<kNofQuantities; i++)
+       layers[layer * kNofQuantities + i] += fCells[index * kNofQuantities + i];
+   }
 
    cout << "\n-------->Hits Collection: in this event: " << endl;
 
-   for (Int_t i=0; i<nofHits; i++) (*fCalCollection)[i]->Print();
+   for (Int_t i=0; i<fNbOfLayers; i++) {
+     const Double_t* hit = &layers[i * kNofQuantities];
+     cout << "In absorber: " << endl
+          << "   energy deposit (keV): " << hit[kEdepAbs] * 1.0e06 << endl
+          << "   track length (cm): " << hit[kTrakAbs]  << endl
+          << "In gap: " << endl
+          << "   energy deposit (keV): " << hit[kEdepGap] * 1.0e06 << endl
+          << "   track length (cm): " << hit[kTrakGap]  << endl;
+   }
 }
 
 //_____________________________________________________________________________
@@ -241,12 +404,12 @@ void FastShowerCalorimeterSD::PrintTotal() const
   Double_t totEGap=0.;
   Double_t totLGap=0.;
 
-  Int_t nofHits = fCalCollection->GetEntriesFast();
-  for (Int_t i=0; i<nofHits; i++) {
-    totEAbs += GetHit(i)->GetEdepAbs();
-    totLAbs += GetHit(i)->GetTrakAbs();
-    totEGap += GetHit(i)->GetEdepGap();
-    totLGap += GetHit(i)->GetTrakGap();
+  for (Int_t index : fTouchedCells) {
+    const Double_t* hit = &fCells[index * kNofQuantities];
+    totEAbs += hit[kEdepAbs];
+    totLAbs += hit[kTrakAbs];
+    totEGap += hit[kEdepGap];
+    totLGap += hit[kTrakGap];
   }
 
   if(fTotEGap > 0.) {
@@ -31,6 +31,11 @@
 #include <TVirtualMC.h>
 #include <TList.h>
 #include <TThread.h>
+#include <TSystem.h>
+
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
 
 #include "FastShowerDetectorConstruction.h"
 
@@ -54,6 +59,9 @@ FastShowerDetectorConstruction::FastShowerDetectorConstruction()
     fDefaultMaterial("Galactic"),
     fAbsorberMaterial("Lead"),
     fGapMaterial("liquidArgon"),
+    fCuts(),
+    fCutMediumIds(),
+    fCutsResolved(kFALSE),
     fMC(nullptr),
     fConnectedToMCManager(kFALSE)
 {
@@ -66,6 +74,7 @@ FastShowerDetectorConstruction::FastShowerDetectorConstruction()
    fCalorSizeYZ       = 10.;
 
    ComputeCalorParameters();
+   SetDefaultCuts();
 
    if(TMCManager::Instance()) {
      TMCManager::Instance()->ConnectEnginePointer(fMC);
@@ -95,6 +104,55 @@ void FastShowerDetectorConstruction::ComputeCalorParameters()
   fWorldSizeYZ = 1.2*fCalorSizeYZ;
 }
 
+//_____________________________________________________________________________
+void FastShowerDetectorConstruction::SetDefaultCuts()
+{
+/// Fill the cuts table with cuts for e-, gamma equivalent to 1mm cut in G4.
+
+  // Medium, CUTGAM and BCUTE, CUTELE and DCUTE
+  struct { const char* medium; Double_t gamma; Double_t electron; } cuts[] = {
+    { "Aluminium",    10.e-06,    597.e-06 },
+    { "liquidArgon",  6.178e-06,  342.9e-06 },
+    { "Lead",         100.5e-06,  1.378e-03 },
+    { "Water",        2.902e-06,  347.2e-06 },
+    { "Scintillator", 2.369e-06,  355.8e-06 },
+    { "Mylar",        2.978e-06,  417.5e-06 },
+    { "quartz",       5.516e-06,  534.1e-06 },
+    { "Air",          990.e-09,   990.e-09 },
+    { "Aerogel",      1.706e-06,  119.0e-06 },
+    { "CarbonicGas",  990.e-09,   990.e-09 },
+    { "WaterSteam",   990.e-09,   990.e-09 },
+    { "Galactic",     100.,       100. },
+    { "Beam",         990.e-09,   990.e-09 }
+  };
+
+  fCuts.clear();
+  for (const auto& cut : cuts) {
+    SetCut(cut.medium, "CUTGAM", cut.gamma);
+    SetCut(cut.medium, "BCUTE",  cut.gamma);
+    SetCut(cut.medium, "CUTELE", cut.electron);
+    SetCut(cut.medium, "DCUTE",  cut.electron);
+  }
+}
+
+//_____________________________________________________________________________
+void FastShowerDetectorConstruction::ResolveCuts()
+{
+/// Look up the medium ID of each entry of the cuts table.
+
+  std::map<std::string, Int_t> mediumIds;
+  fCutMediumIds.resize(fCuts.size());
+  for (std::size_t i=0; i<fCuts.size(); i++) {
+    std::string medium = fCuts[i].fMedium.Data();
+    auto it = mediumIds.find(medium);
+    if ( it == mediumIds.end() ) {
+      it = mediumIds.insert(std::make_pair(medium, fMC->MediumId(medium.c_str()))).first;
+    }
+    fCutMediumIds[i] = it->second;
+  }
+  fCutsResolved = kTRUE;
+}
+
 //
 // public methods
 //
@@ -383,120 +441,120 @@ void FastShowerDetectorConstruction::ConstructGeometry()
 //_____________________________________________________________________________
 void FastShowerDetectorConstruction::SetCuts()
 {
-/// Set cuts for e-, gamma equivalent to 1mm cut in G4.
+/// Apply the cuts table to the current engine. The media are resolved
+/// only once, the engines of a multi-engine run share the same geometry.
 
   if(!fConnectedToMCManager) {
     fMC = gMC;
   }
 
-  Int_t mediumId = fMC->MediumId("Aluminium");
-  if ( mediumId ) {
-    fMC->Gstpar(mediumId, "CUTGAM", 10.e-06);
-    fMC->Gstpar(mediumId, "BCUTE",  10.e-06);
-    fMC->Gstpar(mediumId, "CUTELE", 597.e-06);
-    fMC->Gstpar(mediumId, "DCUTE",  597.e-06);
-  }
-
-  mediumId = fMC->MediumId("liquidArgon");
-  if ( mediumId ) {
-    fMC->Gstpar(mediumId, "CUTGAM", 6.178e-06);
-    fMC->Gstpar(mediumId, "BCUTE",  6.178e-06);
-    fMC->Gstpar(mediumId, "CUTELE", 342.9e-06);
-    fMC->Gstpar(mediumId, "DCUTE",  342.9e-06);
-  }
-
-  mediumId = fMC->MediumId("Lead");
-  if ( mediumId ) {
-    fMC->Gstpar(mediumId, "CUTGAM", 100.5e-06);
-    fMC->Gstpar(mediumId, "BCUTE",  100.5e-06);
-    fMC->Gstpar(mediumId, "CUTELE", 1.378e-03);
-    fMC->Gstpar(mediumId, "DCUTE",  1.378e-03);
-  }
-
-  mediumId = fMC->MediumId("Water");
-  if ( mediumId ) {
-    fMC->Gstpar(mediumId, "CUTGAM", 2.902e-06);
-    fMC->Gstpar(mediumId, "BCUTE",  2.902e-06);
-    fMC->Gstpar(mediumId, "CUTELE", 347.2e-06);
-    fMC->Gstpar(mediumId, "DCUTE",  347.2e-06);
-  }
-
-  mediumId = fMC->MediumId("Scintillator");
-  if ( mediumId ) {
-    fMC->Gstpar(mediumId, "CUTGAM", 2.369e-06);
-    fMC->Gstpar(mediumId, "BCUTE",  2.369e-06);
-    fMC->Gstpar(mediumId, "CUTELE", 355.8e-06);
-    fMC->Gstpar(mediumId, "DCUTE",  355.8e-06);
-  }
+  if ( !fCutsResolved ) ResolveCuts();
 
-  mediumId = fMC->MediumId("Mylar");
-  if ( mediumId ) {
-    fMC->Gstpar(mediumId, "CUTGAM", 2.978e-06);
-    fMC->Gstpar(mediumId, "BCUTE",  2.978e-06);
-    fMC->Gstpar(mediumId, "CUTELE", 417.5e-06);
-    fMC->Gstpar(mediumId, "DCUTE",  417.5e-06);
+  for (std::size_t i=0; i<fCuts.size(); i++) {
+    if ( fCutMediumIds[i] ) {
+      fMC->Gstpar(fCutMediumIds[i], fCuts[i].fParameter.Data(), fCuts[i].fValue);
+    }
   }
+}
 
-  mediumId = fMC->MediumId("quartz");
-  if ( mediumId ) {
-    fMC->Gstpar(mediumId, "CUTGAM", 5.516e-06);
-    fMC->Gstpar(mediumId, "BCUTE",  5.516e-06);
-    fMC->Gstpar(mediumId, "CUTELE", 534.1e-06);
-    fMC->Gstpar(mediumId, "DCUTE",  534.1e-06);
+//_____________________________________________________________________________
+Bool_t FastShowerDetectorConstruction::ReadCuts(const TString& fileName)
+{
+/// Replace the cuts table by the one of a text file. Each line holds a
+/// medium name followed by any number of parameter=value pairs, e.g. \n
+/// Lead  CUTGAM=100.5e-06 BCUTE=100.5e-06 CUTELE=1.378e-03 DCUTE=1.378e-03 \n
+/// Lead  COMP=0 PAIR=0 \n
+/// Energies are in GeV; the rest of a line after '#' is ignored.
+/// \return          False if the file cannot be read, the table is then
+///                  not changed
+/// \param fileName  The file name
+
+  std::ifstream file(fileName.Data());
+  if ( !file ) {
+    Warning("ReadCuts", "Cannot open %s, cuts not changed", fileName.Data());
+    return kFALSE;
   }
 
-  mediumId = fMC->MediumId("Air");
-  if ( mediumId ) {
-    fMC->Gstpar(mediumId, "CUTGAM", 990.e-09);
-    fMC->Gstpar(mediumId, "BCUTE",  990.e-09);
-    fMC->Gstpar(mediumId, "CUTELE", 990.e-09);
-    fMC->Gstpar(mediumId, "DCUTE",  990.e-09);
+  std::vector<MediumParameter> cuts;
+  std::string line;
+  Int_t lineNo = 0;
+  while (std::getline(file, line)) {
+    lineNo++;
+    std::istringstream tokens(line.substr(0, line.find('#')));
+    std::string medium;
+    if ( !(tokens >> medium) ) continue;
+
+    std::string entry;
+    while (tokens >> entry) {
+      std::size_t equal = entry.find('=');
+      const char* valueStart = entry.c_str() + equal + 1;
+      char* valueEnd = 0;
+      Double_t value = 0.;
+      if ( equal != std::string::npos ) value = std::strtod(valueStart, &valueEnd);
+      if ( equal == std::string::npos || equal == 0 || valueEnd == valueStart || *valueEnd ) {
+        Warning("ReadCuts", "%s:%d: cannot parse \"%s\", cuts not changed",
+                fileName.Data(), lineNo, entry.c_str());
+        return kFALSE;
+      }
+      MediumParameter cut = { medium, entry.substr(0, equal), value };
+      cuts.push_back(cut);
+    }
   }
 
-  mediumId = fMC->MediumId("Aerogel");
-  if ( mediumId ) {
-    fMC->Gstpar(mediumId, "CUTGAM", 1.706e-06);
-    fMC->Gstpar(mediumId, "BCUTE",  1.706e-06);
-    fMC->Gstpar(mediumId, "CUTELE", 119.0e-06);
-    fMC->Gstpar(mediumId, "DCUTE",  119.0e-06);
-  }
+  fCuts.clear();
+  for (const MediumParameter& cut : cuts) SetCut(cut.fMedium, cut.fParameter, cut.fValue);
+  return kTRUE;
+}
 
-  mediumId = fMC->MediumId("CarbonicGas");
-  if ( mediumId ) {
-    fMC->Gstpar(mediumId, "CUTGAM", 990.e-09);
-    fMC->Gstpar(mediumId, "BCUTE",  990.e-09);
-    fMC->Gstpar(mediumId, "CUTELE", 990.e-09);
-    fMC->Gstpar(mediumId, "DCUTE",  990.e-09);
+//_____________________________________________________________________________
+void FastShowerDetectorConstruction::SetCut(const TString& medium,
+                                            const TString& parameter, Double_t value)
+{
+/// Set a medium parameter in the cuts table, replacing a previous value.
+/// \param medium     The medium name
+/// \param parameter  The parameter name, e.g. CUTGAM or PAIR
+/// \param value      The value
+
+  fCutsResolved = kFALSE;
+  for (MediumParameter& cut : fCuts) {
+    if ( cut.fMedium == medium && cut.fParameter == parameter ) {
+      cut.fValue = value;
+      return;
+    }
   }
+  MediumParameter cut = { medium, parameter, value };
+  fCuts.push_back(cut);
+}
 
-  mediumId = fMC->MediumId("WaterSteam");
-  if ( mediumId ) {
-    fMC->Gstpar(mediumId, "CUTGAM", 990.e-09);
-    fMC->Gstpar(mediumId, "BCUTE",  990.e-09);
-    fMC->Gstpar(mediumId, "CUTELE", 990.e-09);
-    fMC->Gstpar(mediumId, "DCUTE",  990.e-09);
+//_____________________________________________________________________________
+void FastShowerDetectorConstruction::ScaleCuts(const TString& medium, Double_t factor)
+{
+/// Multiply the energy cuts (CUTGAM, BCUTE, CUTELE, DCUTE) of a medium,
+/// process controls are kept.
+/// \param medium  The medium name
+/// \param factor  The factor
+
+  Bool_t found = kFALSE;
+  for (MediumParameter& cut : fCuts) {
+    if ( cut.fMedium != medium ) continue;
+    if ( cut.fParameter == "CUTGAM" || cut.fParameter == "BCUTE" ||
+         cut.fParameter == "CUTELE" || cut.fParameter == "DCUTE" ) {
+      cut.fValue *= factor;
+      found = kTRUE;
+    }
   }
+  if ( !found ) Warning("ScaleCuts", "No energy cuts for medium %s", medium.Data());
+}
 
-  mediumId = fMC->MediumId("Galactic");
-  if ( mediumId ) {
-    /*
-    fMC->Gstpar(mediumId, "CUTGAM", 990.e-09);
-    fMC->Gstpar(mediumId, "BCUTE",  990.e-09);
-    fMC->Gstpar(mediumId, "CUTELE", 990.e-09);
-    fMC->Gstpar(mediumId, "DCUTE",  990.e-09);
-    */
-    fMC->Gstpar(mediumId, "CUTGAM", 100.);
-    fMC->Gstpar(mediumId, "BCUTE",  100.);
-    fMC->Gstpar(mediumId, "CUTELE", 100.);
-    fMC->Gstpar(mediumId, "DCUTE",  100.);
-  }
+//_____________________________________________________________________________
+void FastShowerDetectorConstruction::PrintCuts() const
+{
+/// Print the cuts table
 
-  mediumId = fMC->MediumId("Beam");
-  if ( mediumId ) {
-    fMC->Gstpar(mediumId, "CUTGAM", 990.e-09);
-    fMC->Gstpar(mediumId, "BCUTE",  990.e-09);
-    fMC->Gstpar(mediumId, "CUTELE", 990.e-09);
-    fMC->Gstpar(mediumId, "DCUTE",  990.e-09);
+  cout << "\n-------->Medium parameters:" << endl;
+  for (const MediumParameter& cut : fCuts) {
+    cout << setw(16) << cut.fMedium << setw(10) << cut.fParameter
+         << setw(14) << cut.fValue << endl;
   }
 }
 
@@ -534,6 +592,89 @@ void FastShowerDetectorConstruction::PrintCalorParameters()
        << "\n------------------------------------------------------------\n";
 }
 
+//_____________________________________________________________________________
+Bool_t FastShowerDetectorConstruction::ImportGeometry(const TString& fileName)
+{
+/// Import the closed geometry, including materials and media, exported
+/// by ExportGeometry() instead of constructing it.
+/// \return          False if the file cannot be read
+/// \param fileName  The geometry file
+
+  if (gSystem->AccessPathName(fileName.Data())) return kFALSE;
+  if (!TGeoManager::Import(fileName.Data())) {
+    Warning("ImportGeometry", "Cannot import geometry from %s", fileName.Data());
+    return kFALSE;
+  }
+  if (!gGeoManager->IsClosed()) gGeoManager->CloseGeometry();
+
+  ComputeCalorParameters();
+  PrintCalorParameters();
+  return kTRUE;
+}
+
+//_____________________________________________________________________________
+Bool_t FastShowerDetectorConstruction::ExportGeometry(const TString& fileName) const
+{
+/// Export the closed geometry. It is first written to a temporary file
+/// which is then renamed, so that concurrent jobs never import a
+/// partially written file.
+/// \return          False if the geometry cannot be exported
+/// \param fileName  The geometry file
+
+  if (!gGeoManager || !gGeoManager->IsClosed()) {
+    Warning("ExportGeometry", "TGeoManager not existing or geometry not closed yet.");
+    return kFALSE;
+  }
+
+  // Keep the extension which selects the output format (.root, .gdml, ...)
+  Ssiz_t dot = fileName.Last('.');
+  if (dot < fileName.Last('/')) dot = -1;
+  TString stem = fileName;
+  if (dot >= 0) stem.Remove(dot);
+  TString tmpFileName = TString::Format("%s.%d.tmp%s", stem.Data(), gSystem->GetPid(),
+                                        dot >= 0 ? fileName.Data() + dot : "");
+  if (!gGeoManager->Export(tmpFileName.Data()) ||
+      gSystem->Rename(tmpFileName.Data(), fileName.Data()) != 0) {
+    Warning("ExportGeometry", "Cannot export geometry to %s", fileName.Data());
+    gSystem->Unlink(tmpFileName.Data());
+    return kFALSE;
+  }
+  return kTRUE;
+}
+
+//_____________________________________________________________________________
+ULong64_t FastShowerDetectorConstruction::GetParameterHash() const
+{
+/// \return A hash (64-bit FNV-1a) of all parameters the geometry depends on
+
+  // Increase when ConstructMaterials() or ConstructGeometry() change
+  const Int_t kGeometryVersion = 1;
+
+  TString parameters
+    = TString::Format("%d %d %.17g %.17g %.17g %s %s %s",
+                      kGeometryVersion, fNbOfLayers, fAbsorberThickness, fGapThickness,
+                      fCalorSizeYZ, fDefaultMaterial.Data(), fAbsorberMaterial.Data(),
+                      fGapMaterial.Data());
+
+  ULong64_t hash = 14695981039346656037ULL;
+  for (const char* c = parameters.Data(); *c; c++) {
+    hash ^= static_cast<unsigned char>(*c);
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+//_____________________________________________________________________________
+TString FastShowerDetectorConstruction::GetGeometryCacheFile(const TString& directory) const
+{
+/// \return           The file the geometry with the current parameters is
+///                   cached in
+/// \param directory  The cache directory
+
+  return TString::Format("%s/geometry_%016llx.root", directory.Data(),
+                         static_cast<unsigned long long>(GetParameterHash()));
+}
+
 //_____________________________________________________________________________
 void FastShowerDetectorConstruction::SetNbOfLayers(Int_t value)
 {
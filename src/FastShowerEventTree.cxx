@@ -0,0 +1,206 @@
+/// \file FastShowerEventTree.cxx
+/// \brief Implementation of the FastShowerEventTree class
+
+#include <TFile.h>
+#include <TTree.h>
+#include <TError.h>
+
+#include "FastShowerEventTree.h"
+
+namespace {
+  /// Name of the tree in the file
+  const char* kTreeName = "events";
+}
+
+//_____________________________________________________________________________
+void FastShowerEventData::Clear()
+{
+/// Clear the data, the capacity of the vectors is kept.
+
+  fEventNo = 0;
+  fTotalEdepGap = 0.;
+  fProtonEnergy = 0.;
+  fBoundaryParticles = 0;
+  fNbOfCellsY = 1;
+  fNbOfCellsZ = 1;
+  fLayers.clear();
+  fCells.clear();
+  fEdepAbs.clear();
+  fTrakAbs.clear();
+  fEdepGap.clear();
+  fTrakGap.clear();
+  fMultiplicityPdgs.clear();
+  fMultiplicities.clear();
+}
+
+//_____________________________________________________________________________
+FastShowerEventTree::FastShowerEventTree()
+  : fFile(0),
+    fTree(0),
+    fIsWriting(kFALSE),
+    fData(),
+    fIntAddresses(),
+    fFloatAddresses()
+{
+/// Default constructor
+
+  fData.Clear();
+}
+
+//_____________________________________________________________________________
+FastShowerEventTree::~FastShowerEventTree()
+{
+/// Destructor
+
+  Close();
+}
+
+//
+// private methods
+//
+
+//_____________________________________________________________________________
+void FastShowerEventTree::BindBranches(Int_t basketSize)
+{
+/// Create the branches (writing) or set their addresses (reading).
+/// \param basketSize  The basket size of the branches (writing)
+
+  const char* intNames[] = { "layers", "cells", "multiplicityPdgs", "multiplicities" };
+  std::vector<Int_t>* intVectors[]
+    = { &fData.fLayers, &fData.fCells, &fData.fMultiplicityPdgs, &fData.fMultiplicities };
+  const char* floatNames[] = { "edepAbs", "trakAbs", "edepGap", "trakGap" };
+  std::vector<Float_t>* floatVectors[]
+    = { &fData.fEdepAbs, &fData.fTrakAbs, &fData.fEdepGap, &fData.fTrakGap };
+
+  if (fIsWriting) {
+    fTree->Branch("eventNo", &fData.fEventNo, "eventNo/I", basketSize);
+    fTree->Branch("totalEdepGap", &fData.fTotalEdepGap, "totalEdepGap/D", basketSize);
+    fTree->Branch("protonEnergy", &fData.fProtonEnergy, "protonEnergy/D", basketSize);
+    fTree->Branch("boundaryParticles", &fData.fBoundaryParticles, "boundaryParticles/I", basketSize);
+    fTree->Branch("nofCellsY", &fData.fNbOfCellsY, "nofCellsY/I", basketSize);
+    fTree->Branch("nofCellsZ", &fData.fNbOfCellsZ, "nofCellsZ/I", basketSize);
+    for (Int_t i=0; i<4; i++) fTree->Branch(intNames[i], intVectors[i], basketSize);
+    for (Int_t i=0; i<4; i++) fTree->Branch(floatNames[i], floatVectors[i], basketSize);
+    return;
+  }
+
+  fTree->SetBranchAddress("eventNo", &fData.fEventNo);
+  fTree->SetBranchAddress("totalEdepGap", &fData.fTotalEdepGap);
+  fTree->SetBranchAddress("protonEnergy", &fData.fProtonEnergy);
+  fTree->SetBranchAddress("boundaryParticles", &fData.fBoundaryParticles);
+  fTree->SetBranchAddress("nofCellsY", &fData.fNbOfCellsY);
+  fTree->SetBranchAddress("nofCellsZ", &fData.fNbOfCellsZ);
+  // Object branches are bound via a pointer which has to stay in place
+  fIntAddresses.assign(intVectors, intVectors + 4);
+  fFloatAddresses.assign(floatVectors, floatVectors + 4);
+  for (Int_t i=0; i<4; i++) fTree->SetBranchAddress(intNames[i], &fIntAddresses[i]);
+  for (Int_t i=0; i<4; i++) fTree->SetBranchAddress(floatNames[i], &fFloatAddresses[i]);
+}
+
+//
+// public methods
+//
+
+//_____________________________________________________________________________
+Bool_t FastShowerEventTree::OpenForWriting(const std::string& fileName,
+                                           Int_t basketSize, Int_t compression)
+{
+/// Create the output file and the tree.
+/// \return             False if the file cannot be created
+/// \param fileName     The output file name
+/// \param basketSize   The basket size of the branches
+/// \param compression  The ROOT compression settings (100 * algorithm + level)
+
+  Close();
+
+  // Do not leave the output file as the current directory
+  TDirectory::TContext context;
+  fFile = TFile::Open(fileName.c_str(), "RECREATE", "", compression);
+  if (!fFile || fFile->IsZombie()) {
+    ::Error("FastShowerEventTree::OpenForWriting", "Cannot create %s", fileName.c_str());
+    delete fFile;
+    fFile = 0;
+    return kFALSE;
+  }
+  fTree = new TTree(kTreeName, "Calorimeter cells and summaries per event");
+  fTree->SetDirectory(fFile);
+  fIsWriting = kTRUE;
+  BindBranches(basketSize);
+  return kTRUE;
+}
+
+//_____________________________________________________________________________
+Bool_t FastShowerEventTree::OpenForReading(const std::string& fileName)
+{
+/// Open a file written by this class.
+/// \return           False if the file or the tree cannot be read
+/// \param fileName   The input file name
+
+  Close();
+
+  TDirectory::TContext context;
+  fFile = TFile::Open(fileName.c_str(), "READ");
+  if (fFile) fFile->GetObject(kTreeName, fTree);
+  if (!fTree) {
+    ::Error("FastShowerEventTree::OpenForReading", "No event tree in %s", fileName.c_str());
+    delete fFile;
+    fFile = 0;
+    return kFALSE;
+  }
+  fIsWriting = kFALSE;
+  BindBranches(0);
+  return kTRUE;
+}
+
+//_____________________________________________________________________________
+void FastShowerEventTree::Fill(const FastShowerEventData& event)
+{
+/// Add an event to the tree.
+/// \param event  The event data
+
+  if (!fTree || !fIsWriting) return;
+
+  fData = event;
+  fTree->Fill();
+}
+
+//_____________________________________________________________________________
+Bool_t FastShowerEventTree::GetEntry(Long64_t i, FastShowerEventData& event)
+{
+/// Read an event from the tree.
+/// \return         False if there is no such entry
+/// \param i        The entry number
+/// \param event    The event data filled
+
+  if (!fTree || fIsWriting || i < 0 || i >= fTree->GetEntries()) return kFALSE;
+
+  if (fTree->GetEntry(i) <= 0) return kFALSE;
+  event = fData;
+  return kTRUE;
+}
+
+//_____________________________________________________________________________
+void FastShowerEventTree::Close()
+{
+/// Write the tree (if writing) and close the file.
+
+  if (!fFile) return;
+
+  // The tree is written into its own directory, the file
+  if (fIsWriting) fTree->Write();
+  fFile->Close();
+  delete fFile;
+  fFile = 0;
+  fTree = 0;
+  fIsWriting = kFALSE;
+  fIntAddresses.clear();
+  fFloatAddresses.clear();
+}
+
+//_____________________________________________________________________________
+Long64_t FastShowerEventTree::GetEntries() const
+{
+/// \return The number of events in the tree
+
+  return fTree ? fTree->GetEntries() : 0;
+}
@@ -0,0 +1,197 @@
+/// \file FastShowerEventWriter.cxx
+/// \brief Implementation of the FastShowerEventWriter class
+
+#include <Riostream.h>
+#include <TROOT.h>
+
+#include "FastShowerEventWriter.h"
+
+using namespace std;
+
+namespace {
+  /// \return   A duration in seconds
+  /// \param d  The duration
+  Double_t seconds(std::chrono::steady_clock::duration d)
+  {
+    return std::chrono::duration_cast<std::chrono::duration<Double_t>>(d).count();
+  }
+}
+
+//_____________________________________________________________________________
+FastShowerEventWriter::FastShowerEventWriter(FastShowerEventTree* tree, Int_t capacity,
+                                             Bool_t dropWhenFull)
+  : fTree(tree),
+    fCapacity(capacity > 0 ? capacity : 1),
+    fDropWhenFull(dropWhenFull),
+    fSlots(),
+    fHead(0),
+    fDepth(0),
+    fStopping(kFALSE),
+    fThread(),
+    fMutex(),
+    fNotEmpty(),
+    fNotFull(),
+    fNbOfWritten(0),
+    fNbOfDropped(0),
+    fNbOfStalls(0),
+    fMaxDepth(0),
+    fSumDepth(0.),
+    fPushWait(Clock::duration::zero()),
+    fWriterBusy(Clock::duration::zero()),
+    fWriterIdle(Clock::duration::zero())
+{
+/// Standard constructor
+/// \param tree          The tree the events are filled in (opened for writing)
+/// \param capacity      The number of events which can be queued
+/// \param dropWhenFull  Drop events instead of waiting if the queue is full
+}
+
+//_____________________________________________________________________________
+FastShowerEventWriter::~FastShowerEventWriter()
+{
+/// Destructor, the queued events are written
+
+  Stop();
+}
+
+//
+// private methods
+//
+
+//_____________________________________________________________________________
+void FastShowerEventWriter::Run()
+{
+/// The loop of the writer thread.
+
+  // The slot being filled, swapped with the oldest queued event
+  FastShowerEventData event;
+  event.Clear();
+
+  std::unique_lock<std::mutex> lock(fMutex);
+  while (true) {
+    Clock::time_point idleStart = Clock::now();
+    while (fDepth == 0 && !fStopping) fNotEmpty.wait(lock);
+    fWriterIdle += Clock::now() - idleStart;
+    if (fDepth == 0) break;
+
+    std::swap(event, fSlots[fHead]);
+    fHead = (fHead + 1) % fCapacity;
+    fDepth--;
+    fNotFull.notify_one();
+
+    lock.unlock();
+    Clock::time_point busyStart = Clock::now();
+    fTree->Fill(event);
+    Clock::duration busy = Clock::now() - busyStart;
+    lock.lock();
+
+    fWriterBusy += busy;
+    fNbOfWritten++;
+  }
+}
+
+//
+// public methods
+//
+
+//_____________________________________________________________________________
+void FastShowerEventWriter::Start()
+{
+/// Allocate the slots and start the writer thread.
+
+  if (fThread.joinable()) return;
+
+  // The tree is filled concurrently to the histograms of the simulation
+  ROOT::EnableThreadSafety();
+
+  FastShowerEventData empty;
+  empty.Clear();
+  fSlots.assign(fCapacity, empty);
+  fHead = 0;
+  fDepth = 0;
+  fStopping = kFALSE;
+  fThread = std::thread(&FastShowerEventWriter::Run, this);
+}
+
+//_____________________________________________________________________________
+Bool_t FastShowerEventWriter::Push(FastShowerEventData& event)
+{
+/// Queue an event. The data are swapped with a free slot, so \em event
+/// is left with the (stale) content of that slot.
+/// \return        False if the event was dropped
+/// \param event   The event data
+
+  std::unique_lock<std::mutex> lock(fMutex);
+  if (!fThread.joinable()) return kFALSE;
+
+  if (fDepth == fCapacity) {
+    if (fDropWhenFull) {
+      fNbOfDropped++;
+      return kFALSE;
+    }
+    fNbOfStalls++;
+    Clock::time_point waitStart = Clock::now();
+    while (fDepth == fCapacity) fNotFull.wait(lock);
+    fPushWait += Clock::now() - waitStart;
+  }
+
+  std::swap(event, fSlots[(fHead + fDepth) % fCapacity]);
+  fDepth++;
+  fSumDepth += fDepth;
+  if (fDepth > fMaxDepth) fMaxDepth = fDepth;
+  fNotEmpty.notify_one();
+  return kTRUE;
+}
+
+//_____________________________________________________________________________
+void FastShowerEventWriter::Stop()
+{
+/// Write the queued events and join the writer thread.
+
+  if (!fThread.joinable()) return;
+
+  {
+    std::lock_guard<std::mutex> lock(fMutex);
+    fStopping = kTRUE;
+  }
+  fNotEmpty.notify_one();
+  fThread.join();
+}
+
+//_____________________________________________________________________________
+void FastShowerEventWriter::Print() const
+{
+/// Print the queue statistics.
+
+  std::lock_guard<std::mutex> lock(fMutex);
+
+  Long64_t nofPushed = fNbOfWritten + fDepth;
+  cout << "\n-------->Event writer: " << fNbOfWritten << " events written, "
+       << fNbOfDropped << " dropped" << endl
+       << "   queue capacity: " << fCapacity
+       << "   maximum depth: " << fMaxDepth
+       << "   mean depth: " << (nofPushed > 0 ? fSumDepth / nofPushed : 0.) << endl
+       << "   simulation waited for a free slot " << fNbOfStalls << " times, "
+       << seconds(fPushWait) << " s" << endl
+       << "   writer filling: " << seconds(fWriterBusy) << " s"
+       << "   writer idle: " << seconds(fWriterIdle) << " s" << endl;
+}
+
+//_____________________________________________________________________________
+void FastShowerEventWriter::SetCapacity(Int_t capacity)
+{
+/// Set the number of events which can be queued; ignored while running.
+/// \param capacity  The number of slots
+
+  if (fThread.joinable()) return;
+  fCapacity = capacity > 0 ? capacity : 1;
+}
+
+//_____________________________________________________________________________
+void FastShowerEventWriter::SetDropWhenFull(Bool_t dropWhenFull)
+{
+/// Set the back-pressure policy.
+/// \param dropWhenFull  Drop events instead of waiting if the queue is full
+
+  fDropWhenFull = dropWhenFull;
+}
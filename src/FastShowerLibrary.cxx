@@ -0,0 +1,300 @@
+/// \file FastShowerLibrary.cxx
+/// \brief Implementation of the FastShowerLibrary class
+
+#include <algorithm>
+#include <cmath>
+
+#include <Riostream.h>
+#include <TFile.h>
+#include <TParticle.h>
+
+#include "FastShowerLibrary.h"
+#include "FastShowerCalorimeterSD.h"
+
+/// \cond CLASSIMP
+ClassImp(FastShowerLibrary)
+/// \endcond
+
+using namespace std;
+
+//_____________________________________________________________________________
+FastShowerLibrary::FastShowerLibrary(const std::vector<Double_t>& energyEdges,
+                                     Int_t nofPositionBins, Double_t calorSizeYZ,
+                                     const FastShowerCalorimeterSD& calorimeterSD)
+  : TObject(),
+    fEnergyEdges(energyEdges),
+    fNbOfPositionBins(nofPositionBins),
+    fCalorSizeYZ(calorSizeYZ),
+    fNbOfLayers(calorimeterSD.GetNbOfLayers()),
+    fNbOfCellsY(calorimeterSD.GetNbOfCellsY()),
+    fNbOfCellsZ(calorimeterSD.GetNbOfCellsZ()),
+    fEnergies(),
+    fProfiles()
+{
+/// Standard constructor; the profile layout is taken from the calorimeter SD.
+/// \param energyEdges      The incident kinetic energy bin edges (increasing, GeV)
+/// \param nofPositionBins  The number of entry position bins along y and z
+/// \param calorSizeYZ      The calorimeter size y,z component
+/// \param calorimeterSD    The calorimeter SD whose cells are recorded
+
+  if (fEnergyEdges.size() < 2 || fNbOfPositionBins < 1)
+    Fatal("FastShowerLibrary", "Need at least one energy and one position bin");
+
+  Int_t nofBins = (fEnergyEdges.size() - 1) * fNbOfPositionBins * fNbOfPositionBins;
+  fEnergies.resize(nofBins);
+  fProfiles.resize(nofBins);
+}
+
+//_____________________________________________________________________________
+FastShowerLibrary::FastShowerLibrary()
+  : TObject(),
+    fEnergyEdges(),
+    fNbOfPositionBins(0),
+    fCalorSizeYZ(0.),
+    fNbOfLayers(0),
+    fNbOfCellsY(0),
+    fNbOfCellsZ(0),
+    fEnergies(),
+    fProfiles()
+{
+/// Default constructor
+}
+
+//_____________________________________________________________________________
+FastShowerLibrary::~FastShowerLibrary()
+{
+/// Destructor
+}
+
+//
+// static methods
+//
+
+//_____________________________________________________________________________
+std::vector<Double_t> FastShowerLibrary::LogEnergyEdges(Double_t min, Double_t max,
+                                                        Int_t nofBins)
+{
+/// \return         Bin edges equidistant in log(energy)
+/// \param min      The lower edge
+/// \param max      The upper edge
+/// \param nofBins  The number of bins
+
+  std::vector<Double_t> edges(nofBins + 1);
+  Double_t logMin = std::log(min);
+  Double_t step = (std::log(max) - logMin) / nofBins;
+  for (Int_t i=0; i<=nofBins; i++)
+    edges[i] = std::exp(logMin + i * step);
+
+  return edges;
+}
+
+//_____________________________________________________________________________
+FastShowerLibrary* FastShowerLibrary::Load(const char* fileName)
+{
+/// \return          The library read from a file written by WriteToFile(),
+///                  0 if it cannot be read; the caller takes ownership
+/// \param fileName  The ROOT file name
+
+  TFile file(fileName, "READ");
+  if (file.IsZombie()) {
+    ::Error("FastShowerLibrary::Load", "Cannot open %s", fileName);
+    return 0;
+  }
+  FastShowerLibrary* library = dynamic_cast<FastShowerLibrary*>(file.Get("showerLibrary"));
+  if (!library)
+    ::Error("FastShowerLibrary::Load", "No shower library found in %s", fileName);
+  file.Close();
+
+  return library;
+}
+
+//_____________________________________________________________________________
+void FastShowerLibrary::EntryPoint(const TParticle& particle, Double_t faceX,
+                                   Double_t& y, Double_t& z)
+{
+/// Project the production vertex of a particle along its momentum onto the
+/// calorimeter face, the transverse position showers are keyed by.
+/// Particles not moving along x keep their vertex position.
+/// \param particle  The particle
+/// \param faceX     The x position of the calorimeter face
+/// \param y         The entry position y component
+/// \param z         The entry position z component
+
+  y = particle.Vy();
+  z = particle.Vz();
+  if (particle.Px() == 0.) return;
+
+  Double_t path = (faceX - particle.Vx()) / particle.Px();
+  y += path * particle.Py();
+  z += path * particle.Pz();
+}
+
+//
+// private methods
+//
+
+//_____________________________________________________________________________
+Int_t FastShowerLibrary::GetPositionBin(Double_t position) const
+{
+/// \return          The entry position bin; positions outside the
+///                  calorimeter are assigned to the edge bins
+/// \param position  The transverse position (y or z)
+
+  // The calorimeter is centred at y = z = 0
+  Int_t bin = static_cast<Int_t>((position / fCalorSizeYZ + 0.5) * fNbOfPositionBins);
+  if (bin < 0) return 0;
+  if (bin >= fNbOfPositionBins) return fNbOfPositionBins - 1;
+
+  return bin;
+}
+
+//
+// public methods
+//
+
+//_____________________________________________________________________________
+Int_t FastShowerLibrary::FindBin(Double_t energy, Double_t y, Double_t z) const
+{
+/// \return        The library bin, -1 if the energy is outside the library range
+/// \param energy  The incident kinetic energy (GeV)
+/// \param y       The entry position y component
+/// \param z       The entry position z component
+
+  if (energy < fEnergyEdges.front() || energy >= fEnergyEdges.back()) return -1;
+
+  Int_t energyBin
+    = std::upper_bound(fEnergyEdges.begin(), fEnergyEdges.end(), energy) - fEnergyEdges.begin() - 1;
+
+  return (energyBin * fNbOfPositionBins + GetPositionBin(y)) * fNbOfPositionBins
+         + GetPositionBin(z);
+}
+
+//_____________________________________________________________________________
+Int_t FastShowerLibrary::GetNbOfShowers() const
+{
+/// \return  The number of recorded showers
+
+  Int_t nofShowers = 0;
+  for (const std::vector<Float_t>& energies : fEnergies)
+    nofShowers += energies.size();
+
+  return nofShowers;
+}
+
+//_____________________________________________________________________________
+void FastShowerLibrary::Record(Double_t energy, Double_t y, Double_t z,
+                               const FastShowerCalorimeterSD& calorimeterSD)
+{
+/// Add the current content of the calorimeter SD as a shower profile.
+/// Showers outside the energy range of the library are ignored.
+/// \param energy         The incident kinetic energy (GeV)
+/// \param y              The entry position y component
+/// \param z              The entry position z component
+/// \param calorimeterSD  The calorimeter SD
+
+  Int_t bin = FindBin(energy, y, z);
+  if (bin < 0) return;
+
+  std::vector<Float_t>& profiles = fProfiles[bin];
+  std::size_t offset = profiles.size();
+  profiles.resize(offset + GetProfileSize(), 0.);
+
+  Int_t nofCells = calorimeterSD.GetNbOfCells();
+  for (Int_t index : calorimeterSD.GetTouchedCells()) {
+    Int_t layer = index / nofCells;
+    Int_t cell = index % nofCells;
+    profiles[offset + 2 * index]
+      = calorimeterSD.GetCellValue(layer, cell, FastShowerCalorimeterSD::kEdepAbs);
+    profiles[offset + 2 * index + 1]
+      = calorimeterSD.GetCellValue(layer, cell, FastShowerCalorimeterSD::kEdepGap);
+  }
+  fEnergies[bin].push_back(energy);
+}
+
+//_____________________________________________________________________________
+const Float_t* FastShowerLibrary::Sample(Double_t energy, Double_t y, Double_t z,
+                                         Double_t random, Double_t& scale) const
+{
+/// \return        A recorded profile of the bin of the given incident state,
+///                0 if there is none
+/// \param energy  The incident kinetic energy (GeV)
+/// \param y       The entry position y component
+/// \param z       The entry position z component
+/// \param random  A random number uniform in [0, 1) selecting the shower
+/// \param scale   The factor the returned profile should be scaled with
+
+  Int_t bin = FindBin(energy, y, z);
+  if (bin < 0 || fEnergies[bin].empty()) return 0;
+
+  Int_t nofShowers = fEnergies[bin].size();
+  Int_t shower = std::min(static_cast<Int_t>(random * nofShowers), nofShowers - 1);
+  scale = energy / fEnergies[bin][shower];
+
+  return &fProfiles[bin][shower * GetProfileSize()];
+}
+
+//_____________________________________________________________________________
+Bool_t FastShowerLibrary::Add(const FastShowerLibrary& other)
+{
+/// Add the showers of another library with the same binning and layout,
+/// e.g. recorded by another process.
+/// \return       True if the showers were added
+/// \param other  The other library
+
+  if (fEnergyEdges != other.fEnergyEdges ||
+      fNbOfPositionBins != other.fNbOfPositionBins ||
+      fCalorSizeYZ != other.fCalorSizeYZ ||
+      GetProfileSize() != other.GetProfileSize()) {
+    Error("Add", "Libraries differ in binning or layout");
+    return kFALSE;
+  }
+
+  for (std::size_t i=0; i<fEnergies.size(); i++) {
+    fEnergies[i].insert(fEnergies[i].end(),
+                        other.fEnergies[i].begin(), other.fEnergies[i].end());
+    fProfiles[i].insert(fProfiles[i].end(),
+                        other.fProfiles[i].begin(), other.fProfiles[i].end());
+  }
+  return kTRUE;
+}
+
+//_____________________________________________________________________________
+Bool_t FastShowerLibrary::IsCompatible(const FastShowerCalorimeterSD& calorimeterSD) const
+{
+/// \return               True if the profiles match the cells of the SD
+/// \param calorimeterSD  The calorimeter SD
+
+  return fNbOfLayers == calorimeterSD.GetNbOfLayers() &&
+         fNbOfCellsY == calorimeterSD.GetNbOfCellsY() &&
+         fNbOfCellsZ == calorimeterSD.GetNbOfCellsZ();
+}
+
+//_____________________________________________________________________________
+void FastShowerLibrary::WriteToFile(const char* fileName) const
+{
+/// Write the library to a new ROOT file.
+/// \param fileName  The ROOT file name
+
+  TFile file(fileName, "RECREATE");
+  file.WriteTObject(this, "showerLibrary");
+  file.Close();
+}
+
+//_____________________________________________________________________________
+void FastShowerLibrary::Print(Option_t* /*option*/) const
+{
+/// Print the library binning and the number of showers per energy bin.
+
+  cout << "Shower library: " << fNbOfLayers << " layers x "
+       << fNbOfCellsY << " x " << fNbOfCellsZ << " cells, "
+       << fNbOfPositionBins << " x " << fNbOfPositionBins << " position bins" << endl;
+
+  Int_t nofPositionBins = fNbOfPositionBins * fNbOfPositionBins;
+  for (std::size_t i=0; i+1<fEnergyEdges.size(); i++) {
+    Int_t nofShowers = 0;
+    for (Int_t j=0; j<nofPositionBins; j++)
+      nofShowers += fEnergies[i * nofPositionBins + j].size();
+    cout << "   [" << fEnergyEdges[i] << ", " << fEnergyEdges[i+1] << ") GeV: "
+         << nofShowers << " showers" << endl;
+  }
+}
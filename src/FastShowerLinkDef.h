@@ -20,9 +20,8 @@
 #pragma link C++ class  FastShowerMCApplication+;
 #pragma link C++ class  FastShowerMCStack+;
 #pragma link C++ class  FastShowerDetectorConstruction+;
-#pragma link C++ class  FastShowerCalorHit+;
 #pragma link C++ class  FastShowerCalorimeterSD+;
+#pragma link C++ class  FastShowerLibrary+;
 #pragma link C++ class  FastShowerPrimaryGenerator+;
-#pragma link C++ class  std::stack<TParticle*,deque<TParticle*> >+;
 
 #endif
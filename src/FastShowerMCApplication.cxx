@@ -19,6 +19,9 @@
 #include "FastShowerMCStack.h"
 #include "FastShowerPrimaryGenerator.h"
 #include "FastShowerUtilities.h"
+#include "FastShowerLibrary.h"
+#include "FastShowerTimer.h"
+#include "FastShowerEventWriter.h"
 
 #include <TMCManager.h>
 
@@ -26,8 +29,10 @@
 #include <TFile.h>
 #include <TH1D.h>
 #include <TF1.h>
+#include <TParameter.h>
 #include <TInterpreter.h>
 #include <TStopwatch.h>
+#include <TSystem.h>
 #include <TVirtualMC.h>
 #include <TRandom.h>
 #include <TPDGCode.h>
@@ -39,6 +44,15 @@
 #include <TParticle.h>
 
 #include <TLorentzVector.h>
+#include <TList.h>
+#include <TMCAutoLock.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <sstream>
 
 using namespace std;
 
@@ -46,13 +60,81 @@ using namespace std;
 ClassImp(FastShowerMCApplication)
 /// \endcond
 
+namespace {
+  /// Protect merging of worker histograms into the master
+  TMCMutex mergeMutex = TMCMUTEX_INITIALIZER;
+  /// Protect recording into the shower library shared by the workers
+  TMCMutex libraryMutex = TMCMUTEX_INITIALIZER;
+
+  /// \return The name of the multiplicity histogram of a given species;
+  ///         e+, e- and gammas keep their historical names
+  std::string multiplicityHistogramName(Int_t pdg)
+  {
+    switch(pdg) {
+      case 11:  return "histNElectrons";
+      case -11: return "histNPositrons";
+      case 22:  return "histNPhotons";
+    }
+    return "histNParticles" + std::to_string(pdg);
+  }
+
+  /// Parse the "key=value" options which follow the names on a line of the
+  /// routing map and kill threshold files: "pdg=" takes a comma-separated
+  /// list of non-zero PDG codes, each of \em numberKeys a number.
+  /// \return            False if an option is unknown or cannot be parsed
+  /// \param tokens      The rest of the line
+  /// \param numberKeys  The keys taking a number
+  /// \param pdgs        The PDG codes, unchanged if not given
+  /// \param numbers     The numbers of the keys given
+  /// \param badEntry    The option which cannot be parsed
+  Bool_t parseLineOptions(std::istream& tokens, const std::vector<std::string>& numberKeys,
+                          std::vector<Int_t>& pdgs, std::map<std::string, Double_t>& numbers,
+                          std::string& badEntry)
+  {
+    std::string entry;
+    while(tokens >> entry) {
+      std::size_t equal = entry.find('=');
+      std::string key = entry.substr(0, equal);
+      std::string value = equal == std::string::npos ? "" : entry.substr(equal + 1);
+      Bool_t parsed = !value.empty();
+      if(parsed && key == "pdg") {
+        pdgs.clear();
+        std::istringstream pdgTokens(value);
+        std::string pdg;
+        while(parsed && std::getline(pdgTokens, pdg, ',')) {
+          char* end = 0;
+          pdgs.push_back(std::strtol(pdg.c_str(), &end, 10));
+          parsed = !pdg.empty() && !*end && pdgs.back() != 0;
+        }
+        parsed = parsed && !pdgs.empty();
+      } else if(parsed && std::find(numberKeys.begin(), numberKeys.end(), key) != numberKeys.end()) {
+        char* end = 0;
+        numbers[key] = std::strtod(value.c_str(), &end);
+        parsed = !*end;
+      } else {
+        parsed = kFALSE;
+      }
+      if(!parsed) {
+        badEntry = entry;
+        return kFALSE;
+      }
+    }
+    return kTRUE;
+  }
+}
+
 //_____________________________________________________________________________
 FastShowerMCApplication::FastShowerMCApplication(const char *name, const char *title,
-                                     Bool_t isMulti, Bool_t splitSimulation, Bool_t hasFastSim)
+                                     Bool_t isMulti, Bool_t splitSimulation, Bool_t hasFastSim,
+                                     FastShowerMCStack::EStorage stackStorage,
+                                     FastShowerMCStack::EOrdering stackOrdering)
   : TVirtualMCApplication(name,title),
     fPrintModulo(1),
     fEventNo(0),
+    fNextEventNo(0),
     fVerbose(0),
+    fMonitoringLevel(kStepMonitoring),
+    fStepping(&FastShowerMCApplication::SteppingMonitored),
     fStack(0),
     fDetConstruction(0),
     fCalorimeterSD(0),
@@ -67,6 +149,25 @@ FastShowerMCApplication::FastShowerMCApplication(const char *name, const char *t
     fG3Id(-1),
     fG4Id(-1),
     fFastSimId(-1),
+    fVolumeRoutes(),
+    fDefaultRoute({kMarkLeaving, 0, 0}),
+    fTransferRules(),
+    fRoutingMap(),
+    fKillThresholds(),
+    fMasterApplication(0),
+    fShowerLibrary(0),
+    fTimer(0),
+    fTransferThreshold(0.),
+    fTransfersInEvent(0),
+    fAccumulators(),
+    fEventTree(0),
+    fEventWriter(0),
+    fGeometryCacheDir(),
+    fRunEvents(0),
+    fRunRealTime(0.),
+    fEventData(),
+    fMultiplicityPdgs({11, -11, 22}),
+    mNParticles(fMultiplicityPdgs.size()),
     mStepsX("histStepsX", "histStepsX", 100, -10., 10.),
     mStepsY("histStepsY", "histStepsY", 50, -6., 6.),
     mStepsZ("histStepsZ", "histStepsZ", 50, -6., 6.),
@@ -77,6 +178,8 @@ FastShowerMCApplication::FastShowerMCApplication(const char *name, const char *t
     mPMomElectronsY("histMomElectronsY", "histMomElectronsY", 50, 0., 0.005),
     mPMomElectronsZ("histMomElectronsZ", "histMomElectronsZ", 50, 0., 0.005),
     mEngineVsVolume("histEngineVsVolume", "", 1, 0., 1., 1., 0., 1.),
+    mTransfersPerEngine("histTransfersPerEngine", "track transfers;from engine;to engine", 2, 0., 2., 2, 0., 2.),
+    mTransferTime("histTransferTime", "track transfer time (s);from engine;to engine", 2, 0., 2., 2, 0., 2.),
     fLeft(kFALSE),
     fProtonEnergy(0.),
     fBoundaryParticles(0),
@@ -87,22 +190,31 @@ FastShowerMCApplication::FastShowerMCApplication(const char *name, const char *t
     mHistDepEnergyLArProtonEnergy("histDepEnergyLArProtonEnergy", "", 60, 0., 0.02, 60, 1., 2.)
 {
 /// Standard constructor
-/// \param name   The MC application name
-/// \param title  The MC application description
+/// \param name          The MC application name
+/// \param title         The MC application description
+/// \param stackStorage  The particle storage backend of the stack
+/// \param stackOrdering The order in which the stack pops the tracks
 
   if(splitSimulation && !isMulti) {
     Fatal("FastShowerMCApplication",
           "Cannot split simulation between engines without \"isMulti\" being switched on");
   }
 
+  InitAccumulators();
+
+  if(splitSimulation) {
+    SetDefaultRoutingMap();
+  }
+
   // Create a user stack
-  fStack = new FastShowerMCStack(1000);
+  fStack = new FastShowerMCStack(1000, stackStorage, stackOrdering);
 
   // Create detector construction
   fDetConstruction = new FastShowerDetectorConstruction();
 
   // Create a calorimeter SD
   fCalorimeterSD = new FastShowerCalorimeterSD("Calorimeter", fDetConstruction);
+  fStack->SetLocalDepositFunction([this](Double_t edep) { fCalorimeterSD->AddLocalDeposit(edep); });
 
   // Create a primary generator
   fPrimaryGenerator = new FastShowerPrimaryGenerator(fStack);
@@ -125,30 +237,85 @@ FastShowerMCApplication::FastShowerMCApplication(const FastShowerMCApplication&
   : TVirtualMCApplication(origin.GetName(),origin.GetTitle()),
     fPrintModulo(origin.fPrintModulo),
     fEventNo(0),
+    fNextEventNo(0),
     fVerbose(origin.fVerbose),
+    fMonitoringLevel(origin.fMonitoringLevel),
+    fStepping(origin.fStepping),
     fStack(0),
     fDetConstruction(origin.fDetConstruction),
     fCalorimeterSD(0),
     fPrimaryGenerator(0),
     fMagField(0),
     fOldGeometry(origin.fOldGeometry),
+    fIsControls(origin.fIsControls),
     fIsMaster(kFALSE),
     fIsMultiRun(origin.fIsMultiRun),
     fSplitSimulation(origin.fSplitSimulation),
     fHasFastSim(origin.fHasFastSim),
     fG3Id(origin.fG3Id),
     fG4Id(origin.fG4Id),
-    fFastSimId(origin.fFastSimId)
+    fFastSimId(origin.fFastSimId),
+    fVolumeRoutes(origin.fVolumeRoutes),
+    fDefaultRoute(origin.fDefaultRoute),
+    fTransferRules(origin.fTransferRules),
+    fRoutingMap(origin.fRoutingMap),
+    fKillThresholds(origin.fKillThresholds),
+    fMasterApplication(const_cast<FastShowerMCApplication*>(&origin)),
+    fShowerLibrary(origin.fShowerLibrary),
+    fTimer(origin.fTimer ? new FastShowerTimer() : 0),
+    fTransferThreshold(origin.fTransferThreshold),
+    fTransfersInEvent(0),
+    fAccumulators(),
+    fEventTree(0),
+    fEventWriter(0),
+    fGeometryCacheDir(),
+    fRunEvents(0),
+    fRunRealTime(0.),
+    fEventData(),
+    fMultiplicityPdgs(origin.fMultiplicityPdgs),
+    mNParticles(fMultiplicityPdgs.size()),
+    mStepsX(origin.mStepsX),
+    mStepsY(origin.mStepsY),
+    mStepsZ(origin.mStepsZ),
+    mPVElectronsX(origin.mPVElectronsX),
+    mPVElectronsY(origin.mPVElectronsY),
+    mPVElectronsZ(origin.mPVElectronsZ),
+    mPMomElectronsX(origin.mPMomElectronsX),
+    mPMomElectronsY(origin.mPMomElectronsY),
+    mPMomElectronsZ(origin.mPMomElectronsZ),
+    mEngineVsVolume(origin.mEngineVsVolume),
+    mTransfersPerEngine(origin.mTransfersPerEngine),
+    mTransferTime(origin.mTransferTime),
+    fLeft(kFALSE),
+    fProtonEnergy(0.),
+    fBoundaryParticles(0),
+    fHistBoudaryX(origin.fHistBoudaryX),
+    fHistBoudaryY(origin.fHistBoudaryY),
+    fHistBoudaryZ(origin.fHistBoudaryZ),
+    mHistDepEnergyLAr(origin.mHistDepEnergyLAr),
+    mHistDepEnergyLArProtonEnergy(origin.mHistDepEnergyLArProtonEnergy)
 {
 /// Copy constructor for cloning application on workers (in multithreading mode)
+/// The histograms are copied with their binning but start empty; they are
+/// accumulated per worker and merged into the master in FinishWorkerRun().
 /// \param origin   The source MC application
 
+  // Worker histograms are owned by the application, not by any directory
+  for(TH1* histogram : GetHistograms()) {
+    histogram->SetDirectory(nullptr);
+    histogram->Reset();
+  }
+  InitAccumulators();
+
   // Create new user stack
-  fStack = new FastShowerMCStack(1000);
+  fStack = new FastShowerMCStack(origin.fStack->GetCapacity(), origin.fStack->GetStorage(),
+                                 origin.fStack->GetOrdering());
 
   // Create a calorimeter SD
   fCalorimeterSD
     = new FastShowerCalorimeterSD(*(origin.fCalorimeterSD), fDetConstruction);
+  fStack->SetLocalDepositFunction([this](Double_t edep) { fCalorimeterSD->AddLocalDeposit(edep); });
+  fStack->CopyKillThresholds(*origin.fStack);
 
   // Create a primary generator
   fPrimaryGenerator
@@ -169,6 +336,9 @@ FastShowerMCApplication::FastShowerMCApplication()
   : TVirtualMCApplication(),
     fPrintModulo(1),
     fEventNo(0),
+    fNextEventNo(0),
+    fMonitoringLevel(kStepMonitoring),
+    fStepping(&FastShowerMCApplication::SteppingMonitored),
     fStack(0),
     fDetConstruction(0),
     fCalorimeterSD(0),
@@ -182,7 +352,26 @@ FastShowerMCApplication::FastShowerMCApplication()
     fHasFastSim(kFALSE),
     fG3Id(-1),
     fG4Id(-1),
-    fFastSimId(-1)
+    fFastSimId(-1),
+    fVolumeRoutes(),
+    fDefaultRoute({kMarkLeaving, 0, 0}),
+    fTransferRules(),
+    fRoutingMap(),
+    fKillThresholds(),
+    fMasterApplication(0),
+    fShowerLibrary(0),
+    fTimer(0),
+    fTransferThreshold(0.),
+    fTransfersInEvent(0),
+    fAccumulators(),
+    fEventTree(0),
+    fEventWriter(0),
+    fGeometryCacheDir(),
+    fRunEvents(0),
+    fRunRealTime(0.),
+    fEventData(),
+    fMultiplicityPdgs(),
+    mNParticles()
 {
 /// Default constructor
 }
@@ -199,6 +388,9 @@ FastShowerMCApplication::~FastShowerMCApplication()
   delete fCalorimeterSD;
   delete fPrimaryGenerator;
   delete fMagField;
+  delete fTimer;
+  delete fEventWriter;
+  delete fEventTree;
   if(!fIsMultiRun) {
     delete fMC;
   }
@@ -217,6 +409,355 @@ void FastShowerMCApplication::RegisterStack() const
 
 }
 
+//_____________________________________________________________________________
+void FastShowerMCApplication::InitVolumeRoutes()
+{
+/// Resolve the volume IDs and the engine IDs of the routing map once and
+/// fill the routing table consulted in Stepping(). Any volume not listed
+/// explicitly gets the default route, namely tracks are only marked when
+/// leaving it.
+
+
+  fVolumeRoutes.clear();
+  fTransferRules.clear();
+
+  SetVolumeRoute("WRLD", kStopTrack | kCountBoundary);
+
+  UInt_t caloActions = kMarkLeaving;
+  if(fIsMultiRun) {
+    caloActions |= kRecordEngine;
+  }
+  SetVolumeRoute("ABSO", caloActions);
+  SetVolumeRoute("GAPX", caloActions);
+
+  if(!fSplitSimulation) {
+    return;
+  }
+
+  // The rules of a volume are kept in the order of the routing map
+  std::vector<std::string> volumes;
+  for(const RoutingEntry& entry : fRoutingMap) {
+    if(std::find(volumes.begin(), volumes.end(), entry.fVolume) == volumes.end()) {
+      volumes.push_back(entry.fVolume);
+    }
+  }
+  for(const std::string& volume : volumes) {
+    std::vector<TransferRule> rules;
+    for(const RoutingEntry& entry : fRoutingMap) {
+      if(entry.fVolume != volume) {
+        continue;
+      }
+      Int_t engineId = GetEngineId(entry.fEngine);
+      if(engineId < 0) {
+        Warning("InitVolumeRoutes", "Engine %s not found, %s not routed to it",
+                entry.fEngine.c_str(), volume.c_str());
+        continue;
+      }
+      rules.push_back({entry.fPdg, entry.fMaxKinEnergy, engineId});
+    }
+    UInt_t actions = GetVolumeRoute(fMC->VolId(volume.c_str())).fActions;
+    SetVolumeRoute(volume.c_str(), actions | kTransferTrack, rules);
+  }
+}
+
+//_____________________________________________________________________________
+Int_t FastShowerMCApplication::GetEngineId(const std::string& engineName) const
+{
+/// \return           The ID of a registered engine, -1 if not found
+/// \param engineName  The engine name
+
+  for(Int_t i = 0; i < fMCManager->NEngines(); i++) {
+    if(engineName == fMCManager->GetEngine(i)->GetName()) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+//_____________________________________________________________________________
+std::vector<TH1*> FastShowerMCApplication::GetHistograms()
+{
+/// \return All histograms filled during the run
+
+  return { &mStepsX, &mStepsY, &mStepsZ,
+           &mPVElectronsX, &mPVElectronsY, &mPVElectronsZ,
+           &mPMomElectronsX, &mPMomElectronsY, &mPMomElectronsZ,
+           &mEngineVsVolume, &mTransfersPerEngine, &mTransferTime,
+           &fHistBoudaryX, &fHistBoudaryY, &fHistBoudaryZ,
+           &mHistDepEnergyLAr, &mHistDepEnergyLArProtonEnergy };
+}
+
+//_____________________________________________________________________________
+void FastShowerMCApplication::RecordShower()
+{
+/// Record the calorimeter content of this event in the shower library.
+/// The shower is keyed by the kinetic energy of the primary and by its calorimeter
+/// entry point, the vertex projected along the momentum onto the calorimeter face.
+/// Only events with one primary are recorded.
+
+  if(fStack->GetNprimary() != 1) {
+    Warning("RecordShower", "Event %d has %d primaries, not recorded", fEventNo, fStack->GetNprimary());
+    return;
+  }
+
+  TParticle* primary = fStack->GetParticle(0);
+  Double_t y, z;
+  FastShowerLibrary::EntryPoint(*primary, -0.5 * fDetConstruction->GetCalorThickness(), y, z);
+  TMCAutoLock lock(&libraryMutex);
+  fShowerLibrary->Record(primary->Ek(), y, z, *fCalorimeterSD);
+}
+
+//_____________________________________________________________________________
+void FastShowerMCApplication::SetTimerEngineNames()
+{
+/// Report the timing of each engine under its name.
+
+  if(!fTimer) {
+    return;
+  }
+  if(fIsMultiRun) {
+    for(Int_t i = 0; i < fMCManager->NEngines(); i++) {
+      fTimer->SetEngineName(i, fMCManager->GetEngine(i)->GetName());
+    }
+  } else {
+    fTimer->SetEngineName(fMC->GetId(), fMC->GetName());
+  }
+}
+
+//_____________________________________________________________________________
+void FastShowerMCApplication::InitTransferHistograms()
+{
+/// Book one bin per engine in the transfer histograms and label the bins
+/// with the engine names.
+
+  Int_t nofEngines = fMCManager->NEngines();
+  for(TH2D* histogram : {&mTransfersPerEngine, &mTransferTime}) {
+    histogram->SetBins(nofEngines, 0., nofEngines, nofEngines, 0., nofEngines);
+    for(Int_t i = 0; i < nofEngines; i++) {
+      const char* engineName = fMCManager->GetEngine(i)->GetName();
+      histogram->GetXaxis()->SetBinLabel(i + 1, engineName);
+      histogram->GetYaxis()->SetBinLabel(i + 1, engineName);
+    }
+  }
+}
+
+//_____________________________________________________________________________
+std::vector<TH1D*> FastShowerMCApplication::GetAccumulatedHistograms()
+{
+/// \return The histograms filled via accumulators, in the order of EAccumulated
+
+  return { &mStepsX, &mStepsY, &mStepsZ,
+           &mPVElectronsX, &mPVElectronsY, &mPVElectronsZ,
+           &mPMomElectronsX, &mPMomElectronsY, &mPMomElectronsZ,
+           &fHistBoudaryX, &fHistBoudaryY, &fHistBoudaryZ };
+}
+
+//_____________________________________________________________________________
+void FastShowerMCApplication::InitAccumulators()
+{
+/// Create the accumulators with the binning of their histograms.
+
+  std::vector<TH1D*> histograms = GetAccumulatedHistograms();
+  fAccumulators.resize(kNofAccumulated);
+  for(Int_t i = 0; i < kNofAccumulated; i++) {
+    fAccumulators[i].Init(*histograms[i]);
+  }
+}
+
+//_____________________________________________________________________________
+void FastShowerMCApplication::FlushAccumulators()
+{
+/// Move the accumulated entries into their histograms.
+
+  std::vector<TH1D*> histograms = GetAccumulatedHistograms();
+  for(std::size_t i = 0; i < fAccumulators.size(); i++) {
+    fAccumulators[i].Flush(*histograms[i]);
+  }
+}
+
+//_____________________________________________________________________________
+void FastShowerMCApplication::FillEventData()
+{
+/// Collect the data of the current event to be stored.
+
+  fEventData.fEventNo = fEventNo;
+  fEventData.fTotalEdepGap = fCalorimeterSD->GetTotalEdepGap();
+  // Only counted by the monitored stepping
+  Bool_t monitored = (fStepping == &FastShowerMCApplication::SteppingMonitored);
+  fEventData.fProtonEnergy = monitored ? fProtonEnergy : -1.;
+  fEventData.fBoundaryParticles = monitored ? fBoundaryParticles : -1;
+  fEventData.fNbOfCellsY = fCalorimeterSD->GetNbOfCellsY();
+  fEventData.fNbOfCellsZ = fCalorimeterSD->GetNbOfCellsZ();
+
+  fEventData.fLayers.clear();
+  fEventData.fCells.clear();
+  fEventData.fEdepAbs.clear();
+  fEventData.fTrakAbs.clear();
+  fEventData.fEdepGap.clear();
+  fEventData.fTrakGap.clear();
+  Int_t nofCells = fCalorimeterSD->GetNbOfCells();
+  for(Int_t index : fCalorimeterSD->GetTouchedCells()) {
+    Int_t layer = index / nofCells;
+    Int_t cell = index % nofCells;
+    fEventData.fLayers.push_back(layer);
+    fEventData.fCells.push_back(cell);
+    fEventData.fEdepAbs.push_back(fCalorimeterSD->GetCellValue(layer, cell, FastShowerCalorimeterSD::kEdepAbs));
+    fEventData.fTrakAbs.push_back(fCalorimeterSD->GetCellValue(layer, cell, FastShowerCalorimeterSD::kTrakAbs));
+    fEventData.fEdepGap.push_back(fCalorimeterSD->GetCellValue(layer, cell, FastShowerCalorimeterSD::kEdepGap));
+    fEventData.fTrakGap.push_back(fCalorimeterSD->GetCellValue(layer, cell, FastShowerCalorimeterSD::kTrakGap));
+  }
+
+  fEventData.fMultiplicityPdgs = fMultiplicityPdgs;
+  fEventData.fMultiplicities.clear();
+  for(Int_t pdg : fMultiplicityPdgs) {
+    fEventData.fMultiplicities.push_back(fStack->GetNumberOfParticles(pdg));
+  }
+}
+
+//_____________________________________________________________________________
+void FastShowerMCApplication::StoreEvent()
+{
+/// Queue the current event for the writer thread, which is shared by the
+/// workers.
+
+  FastShowerEventWriter* eventWriter
+    = fMasterApplication ? fMasterApplication->fEventWriter : fEventWriter;
+  if(!eventWriter) {
+    return;
+  }
+
+  FillEventData();
+  eventWriter->Push(fEventData);
+}
+
+//_____________________________________________________________________________
+void FastShowerMCApplication::SelectStepping()
+{
+/// Bind Stepping() to the variant needed by the monitoring and verbose
+/// levels, so that the choice is not repeated at each step.
+
+  if(fMonitoringLevel == kNoMonitoring && fVerbose.GetLevel() == 0) {
+    fStepping = &FastShowerMCApplication::SteppingPhysics;
+  } else {
+    fStepping = &FastShowerMCApplication::SteppingMonitored;
+  }
+}
+
+//_____________________________________________________________________________
+void FastShowerMCApplication::RouteTrack(const VolumeRoute& route, Double_t kinEnergy)
+{
+/// Transfer the current track to the engine its volume route selects,
+/// unless it is below the transfer threshold.
+/// \param route      The route of the current volume
+/// \param kinEnergy  The kinetic energy of the current track (GeV)
+
+  Int_t targetEngineId = GetTransferTarget(route, fMC->TrackPid(), kinEnergy);
+  Int_t engineId = fMC->GetId();
+  if(targetEngineId < 0 || targetEngineId == engineId) {
+    return;
+  }
+  if(kinEnergy < fTransferThreshold) {
+    // Deferred, the track is finished in the current engine; counted
+    // once per volume entered
+    if(fMC->IsTrackEntering()) {
+      mTransfersPerEngine.Fill(engineId, engineId);
+    }
+    return;
+  }
+  if(fVerbose.GetLevel() > 0) {
+    Info("Stepping", "Transfer track %i",fStack->GetCurrentTrackNumber());
+  }
+  FastShowerTimer::Clock::time_point start = FastShowerTimer::Clock::now();
+  fMCManager->TransferTrack(targetEngineId);
+  FastShowerTimer::Clock::duration duration = FastShowerTimer::Clock::now() - start;
+  if(fTimer) {
+    fTimer->Add(engineId, FastShowerTimer::kTransferTrack, duration);
+  }
+  mTransfersPerEngine.Fill(engineId, targetEngineId);
+  mTransferTime.Fill(engineId, targetEngineId, std::chrono::duration<Double_t>(duration).count());
+  mTransfersPerPdg.Fill(fMC->TrackPid());
+  fTransfersInEvent++;
+}
+
+//_____________________________________________________________________________
+void FastShowerMCApplication::PrintTransfers() const
+{
+/// Print the track transfers between the engines of the split simulation.
+
+  Long64_t nofEvents = 0;
+  Long64_t nofTransfers = 0;
+  for(std::size_t i = 0; i < mTransfersPerEventVec.size(); i++) {
+    nofEvents += mTransfersPerEventVec[i];
+    nofTransfers += i * static_cast<Long64_t>(mTransfersPerEventVec[i]);
+  }
+
+  cout << "\n-------->Track transfers: " << nofTransfers << " in " << nofEvents << " events";
+  if(nofEvents > 0) {
+    cout << ", " << static_cast<Double_t>(nofTransfers) / nofEvents << " per event";
+  }
+  cout << endl;
+
+  Int_t nofEngines = mTransfersPerEngine.GetNbinsX();
+  for(Int_t from = 1; from <= nofEngines; from++) {
+    for(Int_t to = 1; to <= nofEngines; to++) {
+      Double_t count = mTransfersPerEngine.GetBinContent(from, to);
+      if(count == 0.) {
+        continue;
+      }
+      if(from == to) {
+        cout << "   kept in " << mTransfersPerEngine.GetXaxis()->GetBinLabel(from)
+             << " below " << fTransferThreshold << " GeV: " << count << endl;
+      } else {
+        cout << "   " << mTransfersPerEngine.GetXaxis()->GetBinLabel(from) << " -> "
+             << mTransfersPerEngine.GetYaxis()->GetBinLabel(to) << ": " << count
+             << ", " << mTransferTime.GetBinContent(from, to) << " s" << endl;
+      }
+    }
+  }
+
+  cout << "   per PDG:";
+  std::unordered_map<Int_t, Long64_t> transfersPerPdg;
+  mTransfersPerPdg.AddTo(transfersPerPdg);
+  for(const auto& pdgCount : transfersPerPdg) {
+    cout << " " << pdgCount.first << ": " << pdgCount.second;
+  }
+  cout << endl;
+}
+
+//_____________________________________________________________________________
+void FastShowerMCApplication::Merge(FastShowerMCApplication& worker)
+{
+/// Add histograms and counters accumulated by a worker application.
+/// \param worker  The worker application
+
+  worker.FlushAccumulators();
+
+  std::vector<TH1*> histograms = GetHistograms();
+  std::vector<TH1*> workerHistograms = worker.GetHistograms();
+  for(std::size_t i = 0; i < histograms.size(); i++) {
+    // TH1::Merge also takes care of alphanumeric axes
+    TList list;
+    list.Add(workerHistograms[i]);
+    histograms[i]->Merge(&list);
+  }
+
+  for(std::size_t i = 0; i < mNParticles.size(); i++) {
+    utilities::addVectors(mNParticles[i], worker.mNParticles[i]);
+  }
+  utilities::addVectors(mBoundaryParticlesVec, worker.mBoundaryParticlesVec);
+  utilities::addVectors(mTransfersPerEventVec, worker.mTransfersPerEventVec);
+
+  mStepsPerPdg.Add(worker.mStepsPerPdg);
+  mBoundaryParticlesPerPdg.Add(worker.mBoundaryParticlesPerPdg);
+  mTransfersPerPdg.Add(worker.mTransfersPerPdg);
+
+  if(fTimer && worker.fTimer) {
+    fTimer->Add(*worker.fTimer);
+  }
+
+  fStack->MergeStatistics(*worker.fStack);
+}
+
 //
 // public methods
 //
@@ -247,6 +788,7 @@ void FastShowerMCApplication::InitMC(const char* setup)
   fMC->BuildPhysics();
 
   //RegisterStack();
+  SetTimerEngineNames();
 
   Info("InitMC", "Single run initialised");
 }
@@ -285,6 +827,8 @@ void FastShowerMCApplication::InitMC(std::initializer_list<const char*> setupMac
                                       mc->BuildPhysics();
                                     });
   //RegisterStack();
+  SetTimerEngineNames();
+  InitTransferHistograms();
 
   Info("InitMC", "Multi run initialised");
   if(fHasFastSim) {
@@ -317,6 +861,7 @@ void FastShowerMCApplication::InitMC()
                                         mc->BuildPhysics();
                                       });
     //RegisterStack();
+    InitTransferHistograms();
 
     Info("InitMC", "Multi run initialised");
     if(fHasFastSim) {
@@ -335,6 +880,7 @@ void FastShowerMCApplication::InitMC()
     fMC->Init();
     fMC->BuildPhysics();
   }
+  SetTimerEngineNames();
 }
 
 
@@ -348,33 +894,55 @@ void FastShowerMCApplication::RunMC(Int_t nofEvents)
 
   // Prepare a timer
   TStopwatch timer;
+  fStack->ResetStatistics();
 
   if(!fIsMultiRun) {
     Info("RunMC", "Start single run");
     std::cout << "Simulation entirely done with engine "
               << fMC->GetName() << std::endl;
     timer.Start();
+    if(fEventWriter) {
+      fEventWriter->Start();
+    }
     fMC->ProcessRun(nofEvents);
   } else {
     Info("RunMC", "Start multi run");
     if(fSplitSimulation) {
-      std::cout << "GAPX simulated with engine "
-                << fMCManager->GetEngine(0)->GetName() << "\n"
-                << "ABSO simulated with engine "
-                << fMCManager->GetEngine(1)->GetName() << std::endl;
+      PrintRoutingMap();
     } else {
       std::cout << "Simulation entirely done with engine "
                 << fMCManager->GetCurrentEngine()->GetName() << std::endl;
     }
     timer.Start();
+    if(fEventWriter) {
+      fEventWriter->Start();
+    }
     fMCManager->Run(nofEvents);
   }
   Info("RunMC", "Transport finished.");
   timer.Stop();
   Double_t realTime = timer.RealTime();
   Double_t cpuTime = timer.CpuTime();
+  fRunEvents = nofEvents;
+  fRunRealTime = realTime;
   std::cout << "Real time: " << realTime << " s\n"
             << "CPU time:  " << cpuTime << " s" << std::endl;
+  if(fTimer) {
+    fTimer->Print();
+  }
+  fStack->PrintStatistics();
+  if(fSplitSimulation) {
+    PrintTransfers();
+  }
+  if(fEventWriter) {
+    // Wait for the queued events before the file is closed
+    fEventWriter->Stop();
+    fEventWriter->Print();
+    Info("RunMC", "Stored %lld events", fEventTree->GetEntries());
+    fEventTree->Close();
+    delete fEventWriter;
+    fEventWriter = 0;
+  }
   FinishRun();
 }
 
@@ -389,12 +957,8 @@ void FastShowerMCApplication::FinishRun()
 //_____________________________________________________________________________
 void FastShowerMCApplication::ExportGeometry(const char* path) const
 {
-  if(!gGeoManager || !gGeoManager->IsClosed()) {
-    Warning("ExportGeometry", "TGeoManager not existing or geometry not closed yet.");
-    return;
-  }
   Info("ExportGeometry", "Export geometry to %s.", path);
-  gGeoManager->Export(path);
+  fDetConstruction->ExportGeometry(path);
 }
 
 //_____________________________________________________________________________
@@ -412,22 +976,79 @@ void FastShowerMCApplication::InitForWorker() const
   fMC->SetStack(fStack);
   fMC->SetMagField(fMagField);
 
+  // The SD keeps its own pointer to the MC of this thread
+  fCalorimeterSD->Initialize();
+
   //RegisterStack();
 }
 
 //_____________________________________________________________________________
 void FastShowerMCApplication::FinishWorkerRun() const
 {
+/// Merge histograms and counters of this worker into the master application
+
   //cout << "FastShowerMCApplication::FinishWorkerRun: " << endl;
+
+  if(!fMasterApplication) {
+    return;
+  }
+
+  TMCAutoLock lock(&mergeMutex);
+  fMasterApplication->Merge(const_cast<FastShowerMCApplication&>(*this));
 }
 
 //_____________________________________________________________________________
 void FastShowerMCApplication::ReadEvent(Int_t i)
 {
-/// Read \em i -th event and prints hits.
+/// Read \em i -th event from the file given in SetEventInput().
+/// The calorimeter cells are restored in the calorimeter SD and the event
+/// summaries are added to the histograms as if the event had been simulated;
+/// the step, track and engine histograms cannot be replayed.
 /// \param i The number of event to be read
 
-  //RegisterStack();
+  if(!fEventTree || fEventTree->IsWriting()) {
+    Warning("ReadEvent", "No event input set");
+    return;
+  }
+  if(!fEventTree->GetEntry(i, fEventData)) {
+    Warning("ReadEvent", "Event %d not found", i);
+    return;
+  }
+
+  if(fEventData.fNbOfCellsY != fCalorimeterSD->GetNbOfCellsY() ||
+     fEventData.fNbOfCellsZ != fCalorimeterSD->GetNbOfCellsZ()) {
+    fCalorimeterSD->SetCellSegmentation(fEventData.fNbOfCellsY, fEventData.fNbOfCellsZ);
+  }
+  fCalorimeterSD->ResetHits();
+  for(std::size_t k = 0; k < fEventData.fLayers.size(); k++) {
+    Double_t values[FastShowerCalorimeterSD::kNofQuantities];
+    values[FastShowerCalorimeterSD::kEdepAbs] = fEventData.fEdepAbs[k];
+    values[FastShowerCalorimeterSD::kTrakAbs] = fEventData.fTrakAbs[k];
+    values[FastShowerCalorimeterSD::kEdepGap] = fEventData.fEdepGap[k];
+    values[FastShowerCalorimeterSD::kTrakGap] = fEventData.fTrakGap[k];
+    fCalorimeterSD->AddCellValues(fEventData.fLayers[k], fEventData.fCells[k], values);
+  }
+  fCalorimeterSD->SetTotalEdepGap(fEventData.fTotalEdepGap);
+
+  fEventNo = fEventData.fEventNo;
+  fProtonEnergy = fEventData.fProtonEnergy;
+  fBoundaryParticles = fEventData.fBoundaryParticles;
+
+  // Replay what FinishEvent() accumulates
+  mHistDepEnergyLAr.Fill(fEventData.fTotalEdepGap);
+  // Negative if stored without monitoring
+  if(fBoundaryParticles >= 0) {
+    mHistDepEnergyLArProtonEnergy.Fill(fEventData.fTotalEdepGap, fProtonEnergy);
+  }
+  if(fEventData.fMultiplicityPdgs != fMultiplicityPdgs) {
+    SetMultiplicityPdgs(fEventData.fMultiplicityPdgs);
+  }
+  for(std::size_t k = 0; k < fMultiplicityPdgs.size(); k++) {
+    utilities::insertIntoVector(mNParticles[k], fEventData.fMultiplicities[k]);
+  }
+  if(fBoundaryParticles >= 0) {
+    utilities::insertIntoVector(mBoundaryParticlesVec, fBoundaryParticles);
+  }
 }
 
 //_____________________________________________________________________________
@@ -442,10 +1063,26 @@ void FastShowerMCApplication::ConstructGeometry()
   if ( fOldGeometry ) {
     Fatal("ConstructGeometry", "Cannot run with old geomtry");
   }
+
+  TString cacheFile;
+  if(!fGeometryCacheDir.empty()) {
+    cacheFile = fDetConstruction->GetGeometryCacheFile(fGeometryCacheDir.c_str());
+    if(fDetConstruction->ImportGeometry(cacheFile)) {
+      Info("ConstructGeometry", "Geometry imported from cache %s", cacheFile.Data());
+      return;
+    }
+  }
+
   fDetConstruction->ConstructMaterials();
   fDetConstruction->ConstructGeometry();
-  //TGeoManager::Import("geometry.root");
   //fMC->SetRootGeometry();
+
+  if(!cacheFile.IsNull()) {
+    gSystem->mkdir(fGeometryCacheDir.c_str(), kTRUE);
+    if(fDetConstruction->ExportGeometry(cacheFile)) {
+      Info("ConstructGeometry", "Geometry stored in cache %s", cacheFile.Data());
+    }
+  }
 }
 
 //_____________________________________________________________________________
@@ -461,6 +1098,19 @@ void FastShowerMCApplication::InitGeometry()
     fDetConstruction->SetControls();
 
   fCalorimeterSD->Initialize();
+
+  InitVolumeRoutes();
+
+  for(const KillThreshold& threshold : fKillThresholds) {
+    fStack->SetKillThreshold(fMC->MediumId(threshold.fMedium.c_str()), threshold.fPdg,
+                             threshold.fKinEnergy, threshold.fSurvival);
+  }
+  // The stack only sees the secondaries to be tracked by the engines which
+  // leave the tracking order to the VMC stack
+  if(!fKillThresholds.empty() && TString(fMC->GetName()) == "TGeant4") {
+    Warning("InitGeometry", "Kill thresholds have no effect in TGeant4, which keeps its "
+                            "secondaries on its own stack");
+  }
 }
 
 //_____________________________________________________________________________
@@ -526,6 +1176,8 @@ void FastShowerMCApplication::GeneratePrimaries()
 {
 /// Fill the user stack (derived from TVirtualMCStack) with primary particles.
 
+  FastShowerTimer::Guard timer(fTimer, fMC->GetId(), FastShowerTimer::kGeneratePrimaries);
+
   fVerbose.GeneratePrimaries();
 
   TVector3 origin(fDetConstruction->GetWorldSizeX(),
@@ -540,9 +1192,12 @@ void FastShowerMCApplication::BeginEvent()
 {
 /// User actions at beginning of event
 
+  FastShowerTimer::Guard timer(fTimer, fMC->GetId(), FastShowerTimer::kBeginEvent);
+
   fVerbose.BeginEvent();
 
   fBoundaryParticles = 0;
+  fTransfersInEvent = 0;
 
   // Clear TGeo tracks (if filled)
   if (   !fIsMultiRun &&
@@ -555,7 +1210,9 @@ void FastShowerMCApplication::BeginEvent()
        //if (gPad) gPad->Clear();
   }
 
-  fEventNo++;
+  // Workers take their numbers from the master, so that they are unique
+  FastShowerMCApplication* numbering = fMasterApplication ? fMasterApplication : this;
+  fEventNo = ++numbering->fNextEventNo;
   if (fEventNo % fPrintModulo == 0) {
     cout << "\n---> Begin of event: " << fEventNo << endl;
     // ??? How to do this in VMC
@@ -586,19 +1243,28 @@ void FastShowerMCApplication::PreTrack()
 /// the decay products of the primary track (K0Short)
 /// are printed on the screen.
 
+  FastShowerTimer::Guard timer(fTimer, fMC->GetId(), FastShowerTimer::kPreTrack);
+
   fLeft = kFALSE;
 
   fVerbose.PreTrack();
 
   TParticle* particle = fStack->GetCurrentTrack();
-  if(particle->GetPdgCode() == 11) {
-    mPVElectronsX.Fill(particle->Vx());
-    mPVElectronsY.Fill(particle->Vy());
-    mPVElectronsZ.Fill(particle->Vz());
 
-    mPMomElectronsX.Fill(particle->Px());
-    mPMomElectronsY.Fill(particle->Py());
-    mPMomElectronsZ.Fill(particle->Pz());
+  // Only Russian roulette survivors and their secondaries have a weight
+  // other than 1
+  if(!fKillThresholds.empty()) {
+    fCalorimeterSD->SetTrackWeight(particle->GetWeight());
+  }
+
+  if(fMonitoringLevel > kNoMonitoring && particle->GetPdgCode() == 11) {
+    fAccumulators[kPVElectronsX].Fill(particle->Vx());
+    fAccumulators[kPVElectronsY].Fill(particle->Vy());
+    fAccumulators[kPVElectronsZ].Fill(particle->Vz());
+
+    fAccumulators[kPMomElectronsX].Fill(particle->Px());
+    fAccumulators[kPMomElectronsY].Fill(particle->Py());
+    fAccumulators[kPMomElectronsZ].Fill(particle->Pz());
 
   }
 
@@ -623,14 +1289,55 @@ void FastShowerMCApplication::PreTrack()
 //_____________________________________________________________________________
 void FastShowerMCApplication::Stepping()
 {
-/// User actions at each step
-  TParticle* particle = fStack->GetCurrentTrack();
-  if(strcmp(fMC->CurrentVolName(), "WRLD") == 0 && particle->GetPdgCode() != 2212) {
+/// User actions at each step, done by the variant selected in
+/// SelectStepping()
+
+  (this->*fStepping)();
+}
+
+//_____________________________________________________________________________
+void FastShowerMCApplication::SteppingPhysics()
+{
+/// User actions at each step without any bookkeeping: only what changes
+/// the simulation result, i.e. stopping the tracks, scoring the hits and
+/// routing the tracks between the engines
+
+  FastShowerTimer::Guard timer(fTimer, fMC->GetId(), FastShowerTimer::kStepping);
+
+  Int_t copyNo;
+  const VolumeRoute& route = GetVolumeRoute(fMC->CurrentVolID(copyNo));
+
+  if((route.fActions & kStopTrack) && fMC->TrackPid() != 2212) {
     fMC->StopTrack();
     return;
   }
 
-  if(fMC->IsTrackExiting() && strcmp(fMC->CurrentVolName(), "WRLD") != 0)
+  {
+    FastShowerTimer::Guard hitsTimer(fTimer, fMC->GetId(), FastShowerTimer::kProcessHits);
+    fCalorimeterSD->ProcessHits();
+  }
+
+  if(fSplitSimulation && (route.fActions & kTransferTrack)) {
+    RouteTrack(route, fMC->Etot() - fMC->TrackMass());
+  }
+}
+
+//_____________________________________________________________________________
+void FastShowerMCApplication::SteppingMonitored()
+{
+/// User actions at each step, with the step and boundary bookkeeping
+/// and the verbose printing
+  FastShowerTimer::Guard timer(fTimer, fMC->GetId(), FastShowerTimer::kStepping);
+
+  Int_t copyNo;
+  const VolumeRoute& route = GetVolumeRoute(fMC->CurrentVolID(copyNo));
+
+  if((route.fActions & kStopTrack) && fMC->TrackPid() != 2212) {
+    fMC->StopTrack();
+    return;
+  }
+
+  if(fMC->IsTrackExiting() && (route.fActions & kMarkLeaving))
   {
     fLeft = kTRUE;
   }
@@ -641,15 +1348,15 @@ void FastShowerMCApplication::Stepping()
   fMC->TrackPosition(pos);
   fMC->TrackMomentum(mom);
 
-  if(fLeft && fMC->IsTrackEntering() && strcmp(fMC->CurrentVolName(), "WRLD") == 0)
+  if(fLeft && fMC->IsTrackEntering() && (route.fActions & kCountBoundary))
   {
     fBoundaryParticles++;
     Double_t px, py, pz;
     fMC->TrackMomentum(px, py, pz, fProtonEnergy);
-    fHistBoudaryX.Fill(pos.X());
-    fHistBoudaryY.Fill(pos.Y());
-    fHistBoudaryZ.Fill(pos.Z());
-    utilities::addToMap(mBoundaryParticlesPerPdg, fMC->TrackPid(), 1, 1);
+    fAccumulators[kBoundaryX].Fill(pos.X());
+    fAccumulators[kBoundaryY].Fill(pos.Y());
+    fAccumulators[kBoundaryZ].Fill(pos.Z());
+    mBoundaryParticlesPerPdg.Fill(fMC->TrackPid());
     fLeft = kFALSE;
   }
 
@@ -666,7 +1373,10 @@ void FastShowerMCApplication::Stepping()
 
   fVerbose.Stepping();
 
-  fCalorimeterSD->ProcessHits();
+  {
+    FastShowerTimer::Guard hitsTimer(fTimer, fMC->GetId(), FastShowerTimer::kProcessHits);
+    fCalorimeterSD->ProcessHits();
+  }
 
 
   if(fVerbose.GetLevel() > 0) {
@@ -686,40 +1396,19 @@ void FastShowerMCApplication::Stepping()
   }
 
   // Count pdg steps
-  utilities::addToMap(mStepsPerPdg, fMC->TrackPid(), 1, 1);
+  mStepsPerPdg.Fill(fMC->TrackPid());
 
-  mStepsX.Fill(pos.X());
-  mStepsY.Fill(pos.Y());
-  mStepsZ.Fill(pos.Z());
+  fAccumulators[kStepsX].Fill(pos.X());
+  fAccumulators[kStepsY].Fill(pos.Y());
+  fAccumulators[kStepsZ].Fill(pos.Z());
 
-  if(fIsMultiRun && strcmp(fMC->CurrentVolName(), "ABSO") == 0 || strcmp(fMC->CurrentVolName(), "GAPX") == 0) {
+  if(route.fActions & kRecordEngine) {
     mEngineVsVolume.Fill(fMC->CurrentVolName(), fMC->GetName(), 1.);
   }
 
   // Now transfer track
-  if(fSplitSimulation) {
-
-    if(fHasFastSim && (strcmp(fMC->CurrentVolName(), "ABSO") == 0 || strcmp(fMC->CurrentVolName(), "GAPX") == 0)) {
-      fMCManager->TransferTrack(fFastSimId);
-    }
-
-    else {
-      Int_t targetId = -1;
-      if(fMC->GetId() == 0 && strcmp(fMC->CurrentVolName(), "ABSO") == 0)
-      {
-        targetId = 1;
-      }
-      else if(fMC->GetId() == 1 && strcmp(fMC->CurrentVolName(), "GAPX") == 0)
-      {
-        targetId = 0;
-      }
-      if(targetId > -1) {
-        if(fVerbose.GetLevel() > 0) {
-          Info("Stepping", "Transfer track %i",fStack->GetCurrentTrackNumber());
-        }
-        fMCManager->TransferTrack(targetId);
-      }
-    }
+  if(fSplitSimulation && (route.fActions & kTransferTrack)) {
+    RouteTrack(route, mom.T() - fMC->TrackMass());
   }
 }
 
@@ -727,6 +1416,8 @@ void FastShowerMCApplication::Stepping()
 void FastShowerMCApplication::PostTrack()
 {
 /// User actions after finishing of each track
+  FastShowerTimer::Guard timer(fTimer, fMC->GetId(), FastShowerTimer::kPostTrack);
+
   fVerbose.PostTrack();
 }
 
@@ -747,6 +1438,8 @@ void FastShowerMCApplication::FinishEvent()
 {
 /// User actions after finishing of an event
 
+  FastShowerTimer::Guard timer(fTimer, fMC->GetId(), FastShowerTimer::kFinishEvent);
+
   fVerbose.FinishEvent();
 
   // Geant3 + TGeo
@@ -771,46 +1464,404 @@ void FastShowerMCApplication::FinishEvent()
 
   // Monitor energy deposition
   mHistDepEnergyLAr.Fill(fCalorimeterSD->GetTotalEdepGap());
-  mHistDepEnergyLArProtonEnergy.Fill(fCalorimeterSD->GetTotalEdepGap(), fProtonEnergy);
+  // The boundary particles are only counted by the monitored stepping
+  Bool_t monitored = (fStepping == &FastShowerMCApplication::SteppingMonitored);
+  if(monitored) {
+    mHistDepEnergyLArProtonEnergy.Fill(fCalorimeterSD->GetTotalEdepGap(), fProtonEnergy);
+  }
 
   if (fEventNo % fPrintModulo == 0)
     fCalorimeterSD->PrintTotal();
 
+  if(fShowerLibrary) {
+    RecordShower();
+  }
+
+  StoreEvent();
+
   fCalorimeterSD->EndOfEvent();
 
-  utilities::insertIntoVector(mNElectrons, fStack->GetNumberOfParticles(11));
-  utilities::insertIntoVector(mNPositrons, fStack->GetNumberOfParticles(-11));
-  utilities::insertIntoVector(mNPhotons, fStack->GetNumberOfParticles(22));
+  for(std::size_t i = 0; i < fMultiplicityPdgs.size(); i++) {
+    utilities::insertIntoVector(mNParticles[i], fStack->GetNumberOfParticles(fMultiplicityPdgs[i]));
+  }
 
-  utilities::insertIntoVector(mBoundaryParticlesVec, fBoundaryParticles);
+  if(monitored) {
+    utilities::insertIntoVector(mBoundaryParticlesVec, fBoundaryParticles);
+  }
+  if(fSplitSimulation) {
+    utilities::insertIntoVector(mTransfersPerEventVec, fTransfersInEvent);
+  }
 
   fStack->Reset();
 }
 
+//_____________________________________________________________________________
+void FastShowerMCApplication::SetVolumeRoute(const char* volName, UInt_t actions,
+                                             Int_t targetEngineId)
+{
+/// Set the actions taken in Stepping() for a given volume.
+/// The geometry must be initialised since the volume ID is resolved here.
+/// \param volName         The volume name
+/// \param actions         Bit mask of EVolumeAction
+/// \param targetEngineId  The engine ID all tracks are transferred to (kTransferTrack)
+
+  std::vector<TransferRule> rules;
+  if(targetEngineId >= 0) {
+    rules.push_back({0, std::numeric_limits<Double_t>::max(), targetEngineId});
+  }
+  SetVolumeRoute(volName, actions, rules);
+}
+
+//_____________________________________________________________________________
+void FastShowerMCApplication::SetVolumeRoute(const char* volName, UInt_t actions,
+                                             const std::vector<TransferRule>& rules)
+{
+/// Set the actions taken in Stepping() for a given volume.
+/// The geometry must be initialised since the volume ID is resolved here.
+/// \param volName  The volume name
+/// \param actions  Bit mask of EVolumeAction
+/// \param rules    The target engines of the tracks (kTransferTrack), the
+///                 first rule matching a track applies
+
+  Int_t volId = fMC->VolId(volName);
+  if(volId <= 0) {
+    Warning("SetVolumeRoute", "Volume %s not found, not routed", volName);
+    return;
+  }
+  if(volId >= static_cast<Int_t>(fVolumeRoutes.size())) {
+    fVolumeRoutes.resize(volId + 1, fDefaultRoute);
+  }
+  fVolumeRoutes[volId] = {actions, static_cast<Int_t>(fTransferRules.size()),
+                          static_cast<Int_t>(rules.size())};
+  fTransferRules.insert(fTransferRules.end(), rules.begin(), rules.end());
+}
+
+//_____________________________________________________________________________
+void FastShowerMCApplication::SetDefaultRoutingMap()
+{
+/// Set the routing of the split simulation: with the fast simulation
+/// everything entering the calorimeter goes to it, otherwise Geant3 owns
+/// the absorber and Geant4 the gap.
+
+  fRoutingMap.clear();
+  if(fHasFastSim) {
+    AddRoutingEntry("ABSO", "FastShower");
+    AddRoutingEntry("GAPX", "FastShower");
+  } else {
+    AddRoutingEntry("ABSO", "TGeant3TGeo");
+    AddRoutingEntry("GAPX", "TGeant4");
+  }
+}
+
+//_____________________________________________________________________________
+void FastShowerMCApplication::AddRoutingEntry(const std::string& volume, const std::string& engine,
+                                              Int_t pdg, Double_t maxKinEnergy)
+{
+/// Append an entry to the routing map; the entries of a volume are checked
+/// in the order they were added. Must be called before InitMC().
+/// \param volume        The volume name
+/// \param engine        The name of the engine the tracks are transferred to
+/// \param pdg           The PDG code the entry applies to, 0 for all species
+/// \param maxKinEnergy  The kinetic energy below which the entry applies (GeV)
+
+  fRoutingMap.push_back({volume, engine, pdg, maxKinEnergy});
+}
+
+//_____________________________________________________________________________
+Bool_t FastShowerMCApplication::ReadRoutingMap(const std::string& fileName)
+{
+/// Replace the routing map by the one of a text file. Each line holds a
+/// volume name, an engine name and optionally the species and the
+/// kinetic energy (GeV) below which the line applies, e.g. \n
+/// ABSO  FastShower  pdg=11,-11,22  emax=0.01 \n
+/// ABSO  TGeant4 \n
+/// Tracks not matching any line of their volume stay in their engine;
+/// the rest of a line after '#' is ignored. Must be called before InitMC().
+/// \return          False if the file cannot be read, the map is then
+///                  not changed
+/// \param fileName  The file name
+
+  std::ifstream file(fileName);
+  if(!file) {
+    Warning("ReadRoutingMap", "Cannot open %s, routing not changed", fileName.c_str());
+    return kFALSE;
+  }
+
+  std::vector<RoutingEntry> routingMap;
+  std::string line;
+  Int_t lineNo = 0;
+  while(std::getline(file, line)) {
+    lineNo++;
+    std::istringstream tokens(line.substr(0, line.find('#')));
+    std::string volume;
+    std::string engine;
+    if(!(tokens >> volume)) {
+      continue;
+    }
+    if(!(tokens >> engine)) {
+      Warning("ReadRoutingMap", "%s:%d: no engine given, routing not changed",
+              fileName.c_str(), lineNo);
+      return kFALSE;
+    }
+
+    std::vector<Int_t> pdgs = { 0 };
+    std::map<std::string, Double_t> numbers;
+    std::string entry;
+    if(!parseLineOptions(tokens, {"emax"}, pdgs, numbers, entry)) {
+      Warning("ReadRoutingMap", "%s:%d: cannot parse \"%s\", routing not changed",
+              fileName.c_str(), lineNo, entry.c_str());
+      return kFALSE;
+    }
+    Double_t maxKinEnergy = numbers.count("emax") ? numbers["emax"] : std::numeric_limits<Double_t>::max();
+
+    for(Int_t pdg : pdgs) {
+      routingMap.push_back({volume, engine, pdg, maxKinEnergy});
+    }
+  }
+
+  fRoutingMap = routingMap;
+  return kTRUE;
+}
+
+//_____________________________________________________________________________
+void FastShowerMCApplication::PrintRoutingMap() const
+{
+/// Print the routing map of the split simulation.
+
+  cout << "Routing map:" << endl;
+  for(const RoutingEntry& entry : fRoutingMap) {
+    cout << "   " << std::setw(8) << std::left << entry.fVolume << " -> "
+         << std::setw(12) << entry.fEngine << std::right;
+    if(entry.fPdg != 0) {
+      cout << " pdg=" << entry.fPdg;
+    }
+    if(entry.fMaxKinEnergy < std::numeric_limits<Double_t>::max()) {
+      cout << " emax=" << entry.fMaxKinEnergy;
+    }
+    cout << endl;
+  }
+}
+
+//_____________________________________________________________________________
+void FastShowerMCApplication::AddKillThreshold(const std::string& medium, Int_t pdg,
+                                               Double_t kinEnergy, Double_t survivalProbability)
+{
+/// Do not track secondaries of a species created in a medium below a
+/// kinetic energy. Their kinetic energy is deposited in the calorimeter
+/// cell of the parent or, with a survival probability, they are tracked
+/// with this probability and a weight increased accordingly.
+/// Must be called before InitMC().
+/// \param medium               The medium name
+/// \param pdg                  The PDG code
+/// \param kinEnergy            The kinetic energy threshold (GeV)
+/// \param survivalProbability  The survival probability, 0 for a local deposit
+
+  fKillThresholds.push_back({medium, pdg, kinEnergy, survivalProbability});
+}
+
+//_____________________________________________________________________________
+Bool_t FastShowerMCApplication::ReadKillThresholds(const std::string& fileName)
+{
+/// Replace the thresholds of the secondaries not tracked by those of a text
+/// file. Each line holds a medium name, the species, the kinetic energy
+/// threshold (GeV) and optionally the survival probability, e.g. \n
+/// Lead  pdg=11,-11,22  emax=1.e-03 \n
+/// liquidArgon  pdg=22  emax=1.e-04  survival=0.1 \n
+/// The rest of a line after '#' is ignored. Must be called before InitMC().
+/// \return          False if the file cannot be read, the thresholds are
+///                  then not changed
+/// \param fileName  The file name
+
+  std::ifstream file(fileName);
+  if(!file) {
+    Warning("ReadKillThresholds", "Cannot open %s, thresholds not changed", fileName.c_str());
+    return kFALSE;
+  }
+
+  std::vector<KillThreshold> thresholds;
+  std::string line;
+  Int_t lineNo = 0;
+  while(std::getline(file, line)) {
+    lineNo++;
+    std::istringstream tokens(line.substr(0, line.find('#')));
+    std::string medium;
+    if(!(tokens >> medium)) {
+      continue;
+    }
+
+    std::vector<Int_t> pdgs;
+    std::map<std::string, Double_t> numbers;
+    std::string entry;
+    if(!parseLineOptions(tokens, {"emax", "survival"}, pdgs, numbers, entry)) {
+      Warning("ReadKillThresholds", "%s:%d: cannot parse \"%s\", thresholds not changed",
+              fileName.c_str(), lineNo, entry.c_str());
+      return kFALSE;
+    }
+    Double_t kinEnergy = numbers.count("emax") ? numbers["emax"] : -1.;
+    Double_t survival = numbers.count("survival") ? numbers["survival"] : 0.;
+    if(survival < 0. || survival > 1.) {
+      Warning("ReadKillThresholds", "%s:%d: survival probability %g not in [0, 1], thresholds not changed",
+              fileName.c_str(), lineNo, survival);
+      return kFALSE;
+    }
+    if(pdgs.empty() || kinEnergy < 0.) {
+      Warning("ReadKillThresholds", "%s:%d: species or threshold missing, thresholds not changed",
+              fileName.c_str(), lineNo);
+      return kFALSE;
+    }
+
+    for(Int_t pdg : pdgs) {
+      thresholds.push_back({medium, pdg, kinEnergy, survival});
+    }
+  }
+
+  fKillThresholds = thresholds;
+  return kTRUE;
+}
+
+//_____________________________________________________________________________
+void FastShowerMCApplication::SetShowerLibrary(FastShowerLibrary* library)
+{
+/// Set the shower library the calorimeter content of each event is recorded
+/// into; it is shared with the workers and not owned by the application.
+/// \param library  The shower library, 0 to stop recording
+
+  if(library && !library->IsCompatible(*fCalorimeterSD)) {
+    Error("SetShowerLibrary", "Library layout does not match the calorimeter cells, not recording");
+    return;
+  }
+  fShowerLibrary = library;
+}
+
+//_____________________________________________________________________________
+void FastShowerMCApplication::SetTiming(Bool_t timing)
+{
+/// Switch the timing of the user callbacks on or off.
+/// Must be called before InitMC() to be propagated to the workers.
+/// \param timing  If the callbacks should be timed
+
+  if(timing && !fTimer) {
+    fTimer = new FastShowerTimer();
+  } else if(!timing) {
+    delete fTimer;
+    fTimer = 0;
+  }
+}
+
+//_____________________________________________________________________________
+void FastShowerMCApplication::SetMultiplicityPdgs(const std::vector<Int_t>& pdgs)
+{
+/// Set the species whose number of particles per event is histogrammed.
+/// The counts are taken from the stack, any species comes at no extra cost.
+/// Already accumulated multiplicities are discarded.
+/// \param pdgs  The PDG codes
+
+  fMultiplicityPdgs = pdgs;
+  mNParticles.assign(fMultiplicityPdgs.size(), std::vector<Int_t>());
+}
+
+//_____________________________________________________________________________
+Bool_t FastShowerMCApplication::SetEventOutput(const std::string& fileName,
+                                               Int_t basketSize, Int_t compression)
+{
+/// Store the calorimeter cells and summaries of each event in a tree.
+/// The tree is filled on a writer thread during RunMC() and written at
+/// its end.
+/// \return             False if the file cannot be created
+/// \param fileName     The output file name
+/// \param basketSize   The basket size of the branches
+/// \param compression  The ROOT compression settings (100 * algorithm + level)
+
+  if(!fEventTree) {
+    fEventTree = new FastShowerEventTree();
+  }
+  if(!fEventTree->OpenForWriting(fileName, basketSize, compression)) {
+    return kFALSE;
+  }
+  if(!fEventWriter) {
+    fEventWriter = new FastShowerEventWriter(fEventTree);
+  }
+  return kTRUE;
+}
+
+//_____________________________________________________________________________
+void FastShowerMCApplication::SetEventQueue(Int_t capacity, Bool_t dropWhenFull)
+{
+/// Set the queue between the simulation and the writer thread;
+/// must be called after SetEventOutput().
+/// \param capacity      The number of events which can be queued
+/// \param dropWhenFull  Drop events instead of waiting if the queue is full
+
+  if(!fEventWriter) {
+    Warning("SetEventQueue", "No event output set");
+    return;
+  }
+  fEventWriter->SetCapacity(capacity);
+  fEventWriter->SetDropWhenFull(dropWhenFull);
+}
+
+//_____________________________________________________________________________
+Bool_t FastShowerMCApplication::SetEventInput(const std::string& fileName)
+{
+/// Open a file written via SetEventOutput() for ReadEvent().
+/// \return           False if the file cannot be read
+/// \param fileName   The input file name
+
+  delete fEventWriter;
+  fEventWriter = 0;
+  if(!fEventTree) {
+    fEventTree = new FastShowerEventTree();
+  }
+  return fEventTree->OpenForReading(fileName);
+}
+
+//_____________________________________________________________________________
+Long64_t FastShowerMCApplication::GetNbOfStoredEvents() const
+{
+/// \return The number of events in the event input or output
+
+  return fEventTree ? fEventTree->GetEntries() : 0;
+}
+
+//_____________________________________________________________________________
+void FastShowerMCApplication::SetGeometryCache(const std::string& directory)
+{
+/// Cache the constructed geometry in a directory. The cache file is keyed by
+/// a hash of the calorimeter parameters; if it exists the geometry is
+/// imported instead of constructed, otherwise it is created after the
+/// construction. Must be called before InitMC().
+/// \param directory  The cache directory, empty to switch caching off
+
+  fGeometryCacheDir = directory;
+}
+
+//_____________________________________________________________________________
 void FastShowerMCApplication::WriteHistograms(const std::string& fileName)
 {
+  FlushAccumulators();
+
   TFile file(fileName.c_str(), "RECREATE");
   TH1D histNBoundaryParticles("histNBoundaryParticles", "", mBoundaryParticlesVec.size(), -0.5, mBoundaryParticlesVec.size() - 0.5);
   utilities::vectorToHistogram(mBoundaryParticlesVec, histNBoundaryParticles, [](Int_t bin) {return static_cast<int>(bin);});
-  TH1D histNElectrons("histNElectrons", "", mNElectrons.size(), -0.5, mNElectrons.size() - 0.5);
-  utilities::vectorToHistogram(mNElectrons, histNElectrons, [](Int_t bin) {return static_cast<int>(bin);});
-  TH1D histNPositrons("histNPositrons", "", mNPositrons.size(), -0.5, mNPositrons.size() - 0.5);
-  utilities::vectorToHistogram(mNPositrons, histNPositrons, [](Int_t bin) {return static_cast<int>(bin);});
-  TH1D histNPhotons("histNPhotons", "", mNPhotons.size(), -0.5, mNPhotons.size() - 0.5);
-  utilities::vectorToHistogram(mNPhotons, histNPhotons, [](Int_t bin) {return static_cast<int>(bin);});
+  for(std::size_t i = 0; i < fMultiplicityPdgs.size(); i++) {
+    const std::vector<Int_t>& multiplicities = mNParticles[i];
+    TH1D histNParticles(multiplicityHistogramName(fMultiplicityPdgs[i]).c_str(), "",
+                        multiplicities.size(), -0.5, multiplicities.size() - 0.5);
+    utilities::vectorToHistogram(multiplicities, histNParticles, [](Int_t bin) {return static_cast<int>(bin);});
+    file.WriteTObject(&histNParticles);
+  }
 
   // Do not store "crazy" things
-  std::unordered_map<int, int> stepsPerPDGTmp;
-  for(auto& iter : mStepsPerPdg) {
-    if(std::abs(iter.first) <= 3000) {
-      stepsPerPDGTmp[iter.first] = iter.second;
-    }
-  }
   TH1D histStepsPerPDG("histStepsPerPDG", "", 1, 0., 1.);
-  utilities::mapToHistogram(stepsPerPDGTmp, histStepsPerPDG, [](Int_t bin) {return static_cast<int>(bin);});
+  mStepsPerPdg.FillHistogram(histStepsPerPDG, 3000);
 
   TH1D histBoundaryParticlesPerPdg("histBoundaryParticlesPerPdg", "", 1, 0., 1.);
-  utilities::mapToHistogram(mBoundaryParticlesPerPdg, histBoundaryParticlesPerPdg, [](Int_t bin) {return static_cast<int>(bin);});
+  mBoundaryParticlesPerPdg.FillHistogram(histBoundaryParticlesPerPdg);
+
+  TH1D histTransfersPerPdg("histTransfersPerPdg", "", 1, 0., 1.);
+  mTransfersPerPdg.FillHistogram(histTransfersPerPdg);
+  TH1D histNTransfers("histNTransfers", "", mTransfersPerEventVec.size(), -0.5, mTransfersPerEventVec.size() - 0.5);
+  utilities::vectorToHistogram(mTransfersPerEventVec, histNTransfers, [](Int_t bin) {return static_cast<int>(bin);});
 
   file.WriteTObject(&mStepsX);
   file.WriteTObject(&mStepsY);
@@ -825,6 +1876,8 @@ void FastShowerMCApplication::WriteHistograms(const std::string& fileName)
   file.WriteTObject(&mPMomElectronsZ);
 
   file.WriteTObject(&mEngineVsVolume);
+  file.WriteTObject(&mTransfersPerEngine);
+  file.WriteTObject(&mTransferTime);
 
   file.WriteTObject(&fHistBoudaryX);
   file.WriteTObject(&fHistBoudaryY);
@@ -834,6 +1887,32 @@ void FastShowerMCApplication::WriteHistograms(const std::string& fileName)
 
   file.WriteTObject(&mHistDepEnergyLArProtonEnergy);
 
+  // Throughput and stack usage of the run, not available for merged or
+  // replayed histograms
+  if(fRunEvents > 0) {
+    TParameter<Int_t> runEvents("runEvents", fRunEvents);
+    TParameter<Double_t> runRealTime("runRealTime", fRunRealTime);
+    TParameter<Long64_t> runSteps("runSteps", mStepsPerPdg.GetTotal());
+    TParameter<Int_t> stackMaxTracks("stackMaxTracks", fStack->GetMaxNtrack());
+    TParameter<Double_t> stackAllocations("stackAllocationsPerEvent", fStack->GetAllocationsPerEvent());
+    file.WriteTObject(&runEvents);
+    file.WriteTObject(&runRealTime);
+    file.WriteTObject(&runSteps);
+    file.WriteTObject(&stackMaxTracks);
+    file.WriteTObject(&stackAllocations);
+  }
+
+  if(fTimer) {
+    Int_t nofEngines = fTimer->GetNbOfEngines();
+    TH2D histCallbackTime("histCallbackTime", "time (s)", FastShowerTimer::kNofCallbacks, 0., FastShowerTimer::kNofCallbacks,
+                          nofEngines, 0., nofEngines);
+    TH2D histCallbackCalls("histCallbackCalls", "calls", FastShowerTimer::kNofCallbacks, 0., FastShowerTimer::kNofCallbacks,
+                           nofEngines, 0., nofEngines);
+    fTimer->FillHistograms(histCallbackTime, histCallbackCalls);
+    file.WriteTObject(&histCallbackTime);
+    file.WriteTObject(&histCallbackCalls);
+  }
+
 
   TF1 fit("energyDepositFit", "gaus", 0., 0.02);
   mHistDepEnergyLAr.Fit(&fit);
@@ -845,3 +1924,62 @@ void FastShowerMCApplication::WriteHistograms(const std::string& fileName)
   file.Write();
   file.Close();
 }
+
+//_____________________________________________________________________________
+void FastShowerMCApplication::MergeHistograms(const std::string& fileName)
+{
+/// Add the histograms and counters written by WriteHistograms() to a file,
+/// e.g. by another process of a sharded run.
+/// \param fileName  The ROOT file to be merged
+
+  TFile file(fileName.c_str(), "READ");
+  if(file.IsZombie()) {
+    Error("MergeHistograms", "Cannot open %s", fileName.c_str());
+    return;
+  }
+
+  for(TH1* histogram : GetHistograms()) {
+    TH1* fileHistogram = dynamic_cast<TH1*>(file.Get(histogram->GetName()));
+    if(!fileHistogram) {
+      Warning("MergeHistograms", "Histogram %s not found in %s", histogram->GetName(), fileName.c_str());
+      continue;
+    }
+    TList list;
+    list.Add(fileHistogram);
+    histogram->Merge(&list);
+  }
+
+  if(fTimer) {
+    TH1* times = dynamic_cast<TH1*>(file.Get("histCallbackTime"));
+    TH1* calls = dynamic_cast<TH1*>(file.Get("histCallbackCalls"));
+    if(times && calls) {
+      fTimer->AddHistograms(*times, *calls);
+    }
+  }
+
+  std::vector<std::pair<std::string, std::vector<Int_t>*>> vectors =
+    { {"histNBoundaryParticles", &mBoundaryParticlesVec},
+      {"histNTransfers", &mTransfersPerEventVec} };
+  for(std::size_t i = 0; i < fMultiplicityPdgs.size(); i++) {
+    vectors.push_back({multiplicityHistogramName(fMultiplicityPdgs[i]), &mNParticles[i]});
+  }
+  for(auto& vec : vectors) {
+    TH1* fileHistogram = dynamic_cast<TH1*>(file.Get(vec.first.c_str()));
+    if(fileHistogram) {
+      utilities::histogramToVector(*fileHistogram, *vec.second);
+    }
+  }
+
+  std::vector<std::pair<const char*, FastShowerPdgCounter*>> counters =
+    { {"histStepsPerPDG", &mStepsPerPdg},
+      {"histBoundaryParticlesPerPdg", &mBoundaryParticlesPerPdg},
+      {"histTransfersPerPdg", &mTransfersPerPdg} };
+  for(auto& counter : counters) {
+    TH1* fileHistogram = dynamic_cast<TH1*>(file.Get(counter.first));
+    if(fileHistogram) {
+      counter.second->Add(*fileHistogram);
+    }
+  }
+
+  file.Close();
+}
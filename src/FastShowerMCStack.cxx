@@ -18,11 +18,18 @@
 #include <TParticle.h>
 #include <TClonesArray.h>
 #include <TError.h>
+#include <TRandom.h>
+#include <TVirtualMC.h>
 #include <Riostream.h>
 
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+
 #include "TMCManager.h"
 
 #include "FastShowerMCStack.h"
+#include "FastShowerParticleStore.h"
 
 using namespace std;
 
@@ -31,22 +38,52 @@ ClassImp(FastShowerMCStack)
 /// \endcond
 
 //_____________________________________________________________________________
-FastShowerMCStack::FastShowerMCStack(Int_t size)
-  : fParticles(0),
+FastShowerMCStack::FastShowerMCStack(Int_t size, EStorage storage,
+                                     EOrdering ordering)
+  : fStorage(storage),
+    fOrdering(ordering),
+    fParticles(0),
+    fStore(0),
+    fCurrentQueue(-1),
     fCurrentTrack(-1),
-    fNPrimary(0)
+    fNPrimary(0),
+    fCapacity(0),
+    fMaxNtrack(0),
+    fNbOfEvents(0),
+    fNbOfAllocations(0),
+    fKillThresholds(),
+    fKillCounts(),
+    fLocalDeposit()
 {
 /// Standard constructor
-/// \param size  The stack size
+/// \param size      The stack size
+/// \param storage   The particle storage backend
+/// \param ordering  The order in which the tracks are popped
+
+  if (fStorage == kStructOfArrays)
+    fStore = new FastShowerParticleStore();
+  else
+    fParticles = new TClonesArray("TParticle", size);
 
-  fParticles = new TClonesArray("TParticle", size);
+  Reserve(size);
 }
 
 //_____________________________________________________________________________
 FastShowerMCStack::FastShowerMCStack()
-  : fParticles(0),
+  : fStorage(kClonesArray),
+    fOrdering(kLifo),
+    fParticles(0),
+    fStore(0),
+    fCurrentQueue(-1),
     fCurrentTrack(-1),
-    fNPrimary(0)
+    fNPrimary(0),
+    fCapacity(0),
+    fMaxNtrack(0),
+    fNbOfEvents(0),
+    fNbOfAllocations(0),
+    fKillThresholds(),
+    fKillCounts(),
+    fLocalDeposit()
 {
 /// Default constructor
 }
@@ -58,10 +95,169 @@ FastShowerMCStack::~FastShowerMCStack()
 
   if (fParticles) fParticles->Delete();
   delete fParticles;
+  delete fStore;
 }
 
 // private methods
 
+//_____________________________________________________________________________
+Bool_t FastShowerMCStack::KillSecondary(Int_t pdg, Double_t px, Double_t py, Double_t pz,
+                                        Double_t e, Double_t& weight)
+{
+/// Apply the threshold of the current medium to a secondary. Below the
+/// threshold the secondary either deposits its weighted kinetic energy
+/// locally or survives a Russian roulette with its weight compensated.
+/// \return         True if the secondary is not to be tracked
+/// \param pdg      The PDG code
+/// \param px       The momentum x component
+/// \param py       The momentum y component
+/// \param pz       The momentum z component
+/// \param e        The total energy
+/// \param weight   The weight, increased if the secondary survives
+
+  Int_t mediumId = TVirtualMC::GetMC()->CurrentMedium();
+  if (mediumId < 0 || mediumId >= static_cast<Int_t>(fKillThresholds.size())) return kFALSE;
+
+  for (const KillThreshold& threshold : fKillThresholds[mediumId]) {
+    if (threshold.fPdg != pdg) continue;
+
+    Double_t mass2 = e * e - px * px - py * py - pz * pz;
+    Double_t kinEnergy = e - (mass2 > 0. ? sqrt(mass2) : 0.);
+    if (kinEnergy >= threshold.fKinEnergy) return kFALSE;
+
+    KillCount& count = fKillCounts[pdg];
+    if (threshold.fSurvival > 0.) {
+      if (gRandom->Rndm() < threshold.fSurvival) {
+        weight /= threshold.fSurvival;
+        count.fSurvived++;
+        return kFALSE;
+      }
+    }
+    else {
+      if (fLocalDeposit) fLocalDeposit(kinEnergy * weight);
+      count.fDeposited += kinEnergy * weight;
+    }
+    count.fKilled++;
+    return kTRUE;
+  }
+  return kFALSE;
+}
+
+//_____________________________________________________________________________
+Double_t FastShowerMCStack::GetParticleWeight(Int_t track) const
+{
+/// \return       The weight of a stored particle, without materialising it
+/// \param track  The track number
+
+  if (fStorage == kStructOfArrays) return fStore->GetWeight(track);
+  return static_cast<TParticle*>(fParticles->At(track))->GetWeight();
+}
+
+//_____________________________________________________________________________
+void FastShowerMCStack::PushPending(Int_t track, Int_t pdg, Double_t e)
+{
+/// Add a track to be done according to the ordering policy.
+/// \param track  The track number
+/// \param pdg    The PDG code
+/// \param e      The total energy
+
+  switch (fOrdering) {
+    case kEnergyOrdered:
+      fEnergyHeap.push_back(std::make_pair(e, track));
+      std::push_heap(fEnergyHeap.begin(), fEnergyHeap.end());
+      return;
+
+    case kPerSpecies:
+      // Few species per event, a linear search is fastest
+      for (SpeciesQueue& queue : fSpeciesQueues) {
+        if (queue.fPdg == pdg) {
+          queue.fTracks.push_back(track);
+          return;
+        }
+      }
+      fSpeciesQueues.push_back(SpeciesQueue());
+      fSpeciesQueues.back().fPdg = pdg;
+      fSpeciesQueues.back().fTracks.push_back(track);
+      return;
+
+    default:
+      fTrackStack.push_back(track);
+      return;
+  }
+}
+
+//_____________________________________________________________________________
+Int_t FastShowerMCStack::PopPending()
+{
+/// \return The next track to be done according to the ordering policy,
+///         -1 if there is none
+
+  switch (fOrdering) {
+    case kEnergyOrdered: {
+      if (fEnergyHeap.empty()) return -1;
+      std::pop_heap(fEnergyHeap.begin(), fEnergyHeap.end());
+      Int_t track = fEnergyHeap.back().second;
+      fEnergyHeap.pop_back();
+      return track;
+    }
+
+    case kPerSpecies: {
+      // Stay with the current species until its queue is drained, then take
+      // the species seen first
+      Int_t nofQueues = fSpeciesQueues.size();
+      if (fCurrentQueue < 0 || fCurrentQueue >= nofQueues ||
+          fSpeciesQueues[fCurrentQueue].fTracks.empty()) {
+        fCurrentQueue = -1;
+        for (Int_t i=0; i<nofQueues; i++) {
+          if (!fSpeciesQueues[i].fTracks.empty()) {
+            fCurrentQueue = i;
+            break;
+          }
+        }
+        if (fCurrentQueue < 0) return -1;
+      }
+      std::vector<Int_t>& tracks = fSpeciesQueues[fCurrentQueue].fTracks;
+      Int_t track = tracks.back();
+      tracks.pop_back();
+      return track;
+    }
+
+    default: {
+      if (fTrackStack.empty()) return -1;
+      Int_t track = fTrackStack.back();
+      fTrackStack.pop_back();
+      return track;
+    }
+  }
+}
+
+//_____________________________________________________________________________
+void  FastShowerMCStack::PushTrackToStore(Int_t toBeDone, Int_t parent, Int_t pdg,
+  	                 Double_t px, Double_t py, Double_t pz, Double_t e,
+  		         Double_t vx, Double_t vy, Double_t vz, Double_t tof,
+		         Double_t polx, Double_t poly, Double_t polz,
+		         TMCProcess mech, Int_t& ntr, Double_t weight,
+		         Int_t is)
+{
+/// PushTrack() for the structure-of-arrays backend.
+/// Only the track number goes to the stack, the TParticle is materialised
+/// when the track is popped. TMCManager keeps a pointer to each particle,
+/// hence it is materialised right away in case of multi-run.
+
+  ntr = fStore->Add(pdg, is, parent, px, py, pz, e, vx, vy, vz, tof,
+                    polx, poly, polz, mech, weight);
+
+  if (parent<0) fNPrimary++;
+
+  if (toBeDone) PushPending(ntr, pdg, e);
+
+  /// Forward to the TMCManager in case of multi-run
+  TMCManager* mgr = TMCManager::Instance();
+  if(mgr) {
+    mgr->ForwardTrack(toBeDone, ntr, parent, fStore->GetParticle(ntr));
+  }
+}
+
 // public methods
 
 //_____________________________________________________________________________
@@ -74,7 +270,7 @@ void  FastShowerMCStack::PushTrack(Int_t toBeDone, Int_t parent, Int_t pdg,
 {
 /// Create a new particle and push into stack;
 /// adds it to the particles array (fParticles) and if not done to the
-/// stack (fStack).
+/// tracks to be done, ordered according to the ordering policy.
 /// Use TParticle::fMother[1] to store Track ID.
 /// \param toBeDone  1 if particles should go to tracking, 0 otherwise
 /// \param parent    number of the parent track, -1 if track is primary
@@ -95,6 +291,23 @@ void  FastShowerMCStack::PushTrack(Int_t toBeDone, Int_t parent, Int_t pdg,
 /// \param weight    particle weight
 /// \param is        generation status code
 
+  fPdgCounts[pdg]++;
+
+  if (parent >= 0 && !fKillThresholds.empty()) {
+    // Secondaries carry the weight of their parent, e.g. of a roulette
+    // survivor; the engines of this example push unit weights
+    weight *= GetParticleWeight(parent);
+
+    // Secondaries below the threshold are stored but not tracked
+    if (toBeDone && KillSecondary(pdg, px, py, pz, e, weight)) toBeDone = 0;
+  }
+
+  if (fStorage == kStructOfArrays) {
+    PushTrackToStore(toBeDone, parent, pdg, px, py, pz, e, vx, vy, vz, tof,
+                     polx, poly, polz, mech, ntr, weight, is);
+    return;
+  }
+
   const Int_t kFirstDaughter=-1;
   const Int_t kLastDaughter=-1;
 
@@ -111,7 +324,7 @@ void  FastShowerMCStack::PushTrack(Int_t toBeDone, Int_t parent, Int_t pdg,
 
   if (parent<0) fNPrimary++;
 
-  if (toBeDone) fStack.push(particle);
+  if (toBeDone) PushPending(trackId, pdg, e);
 
   ntr = GetNtrack() - 1;
 
@@ -130,17 +343,16 @@ TParticle* FastShowerMCStack::PopNextTrack(Int_t& itrack)
 /// \param track  The index of the popped track
 
   itrack = -1;
-  if  (fStack.empty()) return 0;
 
-  TParticle* particle = fStack.top();
-  fStack.pop();
+  Int_t track = PopPending();
+  if (track < 0) return 0;
 
-  if (!particle) return 0;
-
-  fCurrentTrack = particle->GetSecondMother();
+  fCurrentTrack = track;
   itrack = fCurrentTrack;
 
-  return particle;
+  if (fStorage == kStructOfArrays) return fStore->GetParticle(fCurrentTrack);
+
+  return (TParticle*)fParticles->At(fCurrentTrack);
 }
 
 //_____________________________________________________________________________
@@ -153,6 +365,8 @@ TParticle* FastShowerMCStack::PopPrimaryForTracking(Int_t i)
   if (i < 0 || i >= fNPrimary)
     Fatal("GetPrimaryForTracking", "Index out of range");
 
+  if (fStorage == kStructOfArrays) return fStore->GetParticle(i);
+
   return (TParticle*)fParticles->At(i);
 }
 
@@ -172,11 +386,160 @@ void FastShowerMCStack::Print(Option_t* /*option*/) const
 //_____________________________________________________________________________
 void FastShowerMCStack::Reset()
 {
-/// Delete contained particles, reset particles array and stack.
+/// Reset particles array and stack. The particle storage is kept for the
+/// next event, the TParticle objects are neither deleted nor cleared.
+
+  Int_t ntrack = GetNtrack();
+  fNbOfEvents++;
+  if (ntrack > fMaxNtrack) fMaxNtrack = ntrack;
+  if (ntrack > fCapacity) {
+    fNbOfAllocations += ntrack - fCapacity;
+    fCapacity = ntrack;
+  }
 
   fCurrentTrack = -1;
   fNPrimary = 0;
-  fParticles->Clear();
+  fTrackStack.clear();
+  fEnergyHeap.clear();
+  for (SpeciesQueue& queue : fSpeciesQueues)
+    queue.fTracks.clear();
+  fCurrentQueue = -1;
+  if (fStorage == kStructOfArrays) {
+    fStore->Clear();
+    if (fStore->GetCapacity() > fCapacity) fCapacity = fStore->GetCapacity();
+  }
+  else
+    fParticles->Clear();
+
+  // Keep the PDG entries, species tend to recur in the next event
+  for (auto& count : fPdgCounts)
+    count.second = 0;
+}
+
+//_____________________________________________________________________________
+void FastShowerMCStack::Reserve(Int_t size)
+{
+/// Allocate the storage for a given number of particles, so that events
+/// with up to this number of tracks do not allocate. Must be called
+/// between events.
+/// \param size  The number of particles
+
+  if (size <= fCapacity) return;
+
+  if (fOrdering == kEnergyOrdered)
+    fEnergyHeap.reserve(size);
+  else if (fOrdering == kLifo)
+    fTrackStack.reserve(size);
+
+  if (fStorage == kStructOfArrays)
+    fStore->Reserve(size);
+  else {
+    // The objects are kept by the array when it is cleared
+    fParticles->ExpandCreateFast(size);
+    fParticles->Clear();
+  }
+  fCapacity = size;
+}
+
+//_____________________________________________________________________________
+void FastShowerMCStack::ResetStatistics()
+{
+/// Reset the track and allocation counts, e.g. at the beginning of a run.
+
+  fMaxNtrack = 0;
+  fNbOfEvents = 0;
+  fNbOfAllocations = 0;
+  fKillCounts.clear();
+}
+
+//_____________________________________________________________________________
+void FastShowerMCStack::MergeStatistics(const FastShowerMCStack& other)
+{
+/// Add the track and allocation counts of another stack, e.g. of a worker.
+/// \param other  The other stack
+
+  if (other.fMaxNtrack > fMaxNtrack) fMaxNtrack = other.fMaxNtrack;
+  fNbOfEvents += other.fNbOfEvents;
+  fNbOfAllocations += other.fNbOfAllocations;
+
+  for (const auto& otherCount : other.fKillCounts) {
+    KillCount& count = fKillCounts[otherCount.first];
+    count.fKilled += otherCount.second.fKilled;
+    count.fSurvived += otherCount.second.fSurvived;
+    count.fDeposited += otherCount.second.fDeposited;
+  }
+}
+
+//_____________________________________________________________________________
+void FastShowerMCStack::PrintStatistics() const
+{
+/// Print the track and allocation counts.
+
+  cout << "\n-------->Stack: maximum " << fMaxNtrack << " tracks per event in "
+       << fNbOfEvents << " events, capacity " << fCapacity << endl
+       << "   particles beyond the capacity: " << fNbOfAllocations << ", "
+       << GetAllocationsPerEvent() << " per event" << endl;
+
+  if (fKillCounts.empty()) return;
+
+  cout << "   secondaries not tracked below the thresholds:" << endl;
+  for (const auto& count : fKillCounts) {
+    cout << "   " << setw(8) << count.first << ": " << count.second.fKilled << " killed";
+    if (fNbOfEvents > 0)
+      cout << " (" << static_cast<Double_t>(count.second.fKilled) / fNbOfEvents << " per event)";
+    cout << ", " << count.second.fSurvived << " survived roulette, "
+         << count.second.fDeposited << " GeV deposited locally" << endl;
+  }
+}
+
+//_____________________________________________________________________________
+void FastShowerMCStack::SetKillThreshold(Int_t mediumId, Int_t pdg, Double_t kinEnergy,
+                                         Double_t survivalProbability)
+{
+/// Do not track secondaries of a species created in a medium below a
+/// kinetic energy. Their energy is deposited locally via the local deposit
+/// function, or, with a survival probability, they are tracked with this
+/// probability and their weight divided by it.
+/// \param mediumId             The medium ID
+/// \param pdg                  The PDG code
+/// \param kinEnergy            The kinetic energy threshold (GeV)
+/// \param survivalProbability  The survival probability, 0 for a local deposit
+
+  if (mediumId < 0) {
+    Warning("SetKillThreshold", "Invalid medium ID %d, threshold ignored", mediumId);
+    return;
+  }
+  if (mediumId >= static_cast<Int_t>(fKillThresholds.size()))
+    fKillThresholds.resize(mediumId + 1);
+
+  KillThreshold threshold = { pdg, kinEnergy, survivalProbability };
+  for (KillThreshold& existing : fKillThresholds[mediumId]) {
+    if (existing.fPdg == pdg) {
+      existing = threshold;
+      return;
+    }
+  }
+  fKillThresholds[mediumId].push_back(threshold);
+}
+
+//_____________________________________________________________________________
+void FastShowerMCStack::CopyKillThresholds(const FastShowerMCStack& other)
+{
+/// Take over the thresholds of another stack, e.g. on a worker.
+/// \param other  The other stack
+
+  fKillThresholds = other.fKillThresholds;
+}
+
+//_____________________________________________________________________________
+void FastShowerMCStack::SetLocalDepositFunction(std::function<void(Double_t)> localDeposit)
+{
+/// Set the function receiving the kinetic energy of the secondaries killed
+/// without Russian roulette. It is called while the parent step is
+/// processed, so the deposit can be attributed to the current position.
+/// \param localDeposit  The function
+
+  fLocalDeposit = localDeposit;
 }
 
 //_____________________________________________________________________________
@@ -193,6 +556,8 @@ Int_t  FastShowerMCStack::GetNtrack() const
 {
 /// \return  The total number of all tracks.
 
+  if (fStorage == kStructOfArrays) return fStore->GetSize();
+
   return fParticles->GetEntriesFast();
 }
 
@@ -230,6 +595,14 @@ Int_t  FastShowerMCStack::GetCurrentParentTrackNumber() const
 {
 /// \return  The current track parent ID.
 
+  if (fStorage == kStructOfArrays) {
+    if (fCurrentTrack < 0 || fCurrentTrack >= fStore->GetSize()) {
+      Warning("GetCurrentParentTrackNumber", "Current track not found in the stack");
+      return -1;
+    }
+    return fStore->GetParent(fCurrentTrack);
+  }
+
   TParticle* current = GetCurrentTrack();
 
   if (current)
@@ -244,22 +617,23 @@ TParticle*  FastShowerMCStack::GetParticle(Int_t id) const
 /// \return   The \em id -th particle in fParticles
 /// \param id The index of the particle to be returned
 
-  if (id < 0 || id >= fParticles->GetEntriesFast())
+  if (id < 0 || id >= GetNtrack())
     Fatal("GetParticle", "Index out of range");
 
+  if (fStorage == kStructOfArrays) return fStore->GetParticle(id);
+
   return (TParticle*)fParticles->At(id);
 }
 
 //_____________________________________________________________________________
 Int_t FastShowerMCStack::GetNumberOfParticles(Int_t pdg) const
 {
-  Int_t n = 0;
-  TIter next(fParticles);
-  while (TObject *obj = next()) {
-    TParticle* particle = dynamic_cast<TParticle*>(obj);
-    if(particle && particle->GetPdgCode() == pdg) {
-      n++;
-    }
-  }
-  return n;
+/// The counts are maintained in PushTrack(), no scan of the particles is done.
+/// \return   The number of particles with the given PDG code pushed in this event
+/// \param pdg The PDG code
+
+  std::unordered_map<Int_t, Int_t>::const_iterator it = fPdgCounts.find(pdg);
+  if (it == fPdgCounts.end()) return 0;
+
+  return it->second;
 }
@@ -0,0 +1,139 @@
+/// \file FastShowerParticleStore.cxx
+/// \brief Implementation of the FastShowerParticleStore class
+
+#include <TParticle.h>
+
+#include "FastShowerParticleStore.h"
+
+//_____________________________________________________________________________
+FastShowerParticleStore::FastShowerParticleStore()
+  : fEvent(1)
+{
+/// Default constructor
+}
+
+//_____________________________________________________________________________
+FastShowerParticleStore::~FastShowerParticleStore()
+{
+/// Destructor
+
+  for (TParticle* view : fViews) delete view;
+}
+
+//_____________________________________________________________________________
+Int_t FastShowerParticleStore::Add(Int_t pdg, Int_t status, Int_t parent,
+                                   Double_t px, Double_t py, Double_t pz, Double_t e,
+                                   Double_t vx, Double_t vy, Double_t vz, Double_t tof,
+                                   Double_t polx, Double_t poly, Double_t polz,
+                                   TMCProcess mech, Double_t weight)
+{
+/// Append a particle to the arrays.
+/// \return  The index of the new particle which is also its track number
+
+  fPdg.push_back(pdg);
+  fStatus.push_back(status);
+  fParent.push_back(parent);
+  fProcess.push_back(mech);
+  fPx.push_back(px);
+  fPy.push_back(py);
+  fPz.push_back(pz);
+  fE.push_back(e);
+  fVx.push_back(vx);
+  fVy.push_back(vy);
+  fVz.push_back(vz);
+  fTof.push_back(tof);
+  fPolx.push_back(polx);
+  fPoly.push_back(poly);
+  fPolz.push_back(polz);
+  fWeight.push_back(weight);
+
+  return GetSize() - 1;
+}
+
+//_____________________________________________________________________________
+void FastShowerParticleStore::Clear()
+{
+/// Remove all particles but keep the allocated memory.
+/// Materialised particles become invalid and are refilled on demand.
+
+  fPdg.clear();
+  fStatus.clear();
+  fParent.clear();
+  fProcess.clear();
+  fPx.clear();
+  fPy.clear();
+  fPz.clear();
+  fE.clear();
+  fVx.clear();
+  fVy.clear();
+  fVz.clear();
+  fTof.clear();
+  fPolx.clear();
+  fPoly.clear();
+  fPolz.clear();
+  fWeight.clear();
+
+  fEvent++;
+}
+
+//_____________________________________________________________________________
+void FastShowerParticleStore::Reserve(Int_t size)
+{
+/// Reserve memory for a given number of particles.
+/// \param size  The number of particles
+
+  fPdg.reserve(size);
+  fStatus.reserve(size);
+  fParent.reserve(size);
+  fProcess.reserve(size);
+  fPx.reserve(size);
+  fPy.reserve(size);
+  fPz.reserve(size);
+  fE.reserve(size);
+  fVx.reserve(size);
+  fVy.reserve(size);
+  fVz.reserve(size);
+  fTof.reserve(size);
+  fPolx.reserve(size);
+  fPoly.reserve(size);
+  fPolz.reserve(size);
+  fWeight.reserve(size);
+}
+
+//_____________________________________________________________________________
+TParticle* FastShowerParticleStore::GetParticle(Int_t id) const
+{
+/// Materialise particle \em id as TParticle if not yet done in this event.
+/// As in FastShowerMCStack, TParticle::fMother[1] holds the track ID and the
+/// creator process is stored as unique ID.
+/// \return   The particle
+/// \param id The index of the particle (no range check)
+
+  if (id >= static_cast<Int_t>(fViews.size())) {
+    fViews.resize(id + 1, 0);
+    fViewEvent.resize(id + 1, 0);
+  }
+
+  TParticle* particle = fViews[id];
+  if (!particle) {
+    particle = new TParticle();
+    fViews[id] = particle;
+  }
+  if (fViewEvent[id] == fEvent) return particle;
+
+  // Set the momentum first, it is needed for the mass of unknown particles
+  particle->SetMomentum(fPx[id], fPy[id], fPz[id], fE[id]);
+  particle->SetProductionVertex(fVx[id], fVy[id], fVz[id], fTof[id]);
+  particle->SetPdgCode(fPdg[id]);
+  particle->SetStatusCode(fStatus[id]);
+  particle->SetFirstMother(fParent[id]);
+  particle->SetLastMother(id);
+  particle->SetFirstDaughter(-1);
+  particle->SetLastDaughter(-1);
+  particle->SetPolarisation(fPolx[id], fPoly[id], fPolz[id]);
+  particle->SetWeight(fWeight[id]);
+  particle->SetUniqueID(fProcess[id]);
+
+  fViewEvent[id] = fEvent;
+  return particle;
+}
@@ -0,0 +1,172 @@
+/// \file FastShowerPdgCounter.cxx
+/// \brief Implementation of the FastShowerPdgCounter class
+
+#include <cmath>
+#include <cstdlib>
+#include <string>
+
+#include <TH1.h>
+
+#include "FastShowerPdgCounter.h"
+
+namespace {
+  /// The species registered at construction, most frequent first
+  const Int_t kShowerPdgs[] = { 22, 11, -11, 2112, 2212, 211, -211, 111, 13, -13,
+                                321, -321, 130, 310, -2112, -2212 };
+}
+
+//_____________________________________________________________________________
+FastShowerPdgCounter::FastShowerPdgCounter()
+  : fSlots(2 * kMaxDirectPdg + 1, -1),
+    fPdgs(),
+    fCounts(),
+    fRareCounts()
+{
+/// Default constructor
+
+  for (Int_t pdg : kShowerPdgs) AddSlot(pdg);
+}
+
+//
+// private methods
+//
+
+//_____________________________________________________________________________
+Int_t FastShowerPdgCounter::AddSlot(Int_t pdg)
+{
+/// Assign a dense slot to a PDG code within the lookup table.
+/// \return     The slot
+/// \param pdg  The PDG code
+
+  Int_t slot = fPdgs.size();
+  fSlots[pdg + kMaxDirectPdg] = slot;
+  fPdgs.push_back(pdg);
+  fCounts.push_back(0);
+  return slot;
+}
+
+//_____________________________________________________________________________
+void FastShowerPdgCounter::Add(Int_t pdg, Long64_t count)
+{
+/// Add a count to a PDG code.
+/// \param pdg    The PDG code
+/// \param count  The count
+
+  if (pdg >= -kMaxDirectPdg && pdg <= kMaxDirectPdg) {
+    Int_t slot = fSlots[pdg + kMaxDirectPdg];
+    if (slot < 0) slot = AddSlot(pdg);
+    fCounts[slot] += count;
+  } else {
+    fRareCounts[pdg] += count;
+  }
+}
+
+//
+// public methods
+//
+
+//_____________________________________________________________________________
+void FastShowerPdgCounter::Add(const FastShowerPdgCounter& other)
+{
+/// Add the counts of another counter, e.g. of a worker.
+/// \param other  The other counter
+
+  for (std::size_t i = 0; i < other.fPdgs.size(); i++) {
+    if (other.fCounts[i] != 0) Add(other.fPdgs[i], other.fCounts[i]);
+  }
+  for (const auto& pdgCount : other.fRareCounts) {
+    fRareCounts[pdgCount.first] += pdgCount.second;
+  }
+}
+
+//_____________________________________________________________________________
+void FastShowerPdgCounter::Add(const TH1& histo)
+{
+/// Add the counts of a histogram filled with FillHistogram(), e.g. read
+/// back from a file.
+/// \param histo  The histogram with one bin labelled by PDG code per species
+
+  for (Int_t bin=1; bin<=histo.GetNbinsX(); bin++) {
+    const char* label = histo.GetXaxis()->GetBinLabel(bin);
+    if (!label || !label[0]) continue;
+    Add(std::atoi(label), std::llround(histo.GetBinContent(bin)));
+  }
+}
+
+//_____________________________________________________________________________
+void FastShowerPdgCounter::AddTo(std::unordered_map<Int_t, Long64_t>& counts, Int_t maxPdg) const
+{
+/// Add the non-zero counts to a map per PDG code.
+/// \param counts  The map filled
+/// \param maxPdg  Skip codes above this absolute value, if positive
+
+  for (std::size_t i = 0; i < fPdgs.size(); i++) {
+    if (fCounts[i] == 0) continue;
+    if (maxPdg > 0 && std::abs(fPdgs[i]) > maxPdg) continue;
+    counts[fPdgs[i]] += fCounts[i];
+  }
+  for (const auto& pdgCount : fRareCounts) {
+    if (maxPdg > 0 && std::abs(pdgCount.first) > maxPdg) continue;
+    counts[pdgCount.first] += pdgCount.second;
+  }
+}
+
+//_____________________________________________________________________________
+void FastShowerPdgCounter::FillHistogram(TH1& histo, Int_t maxPdg) const
+{
+/// Fill the non-zero counts into a histogram with one bin labelled by PDG
+/// code per species, sorted by decreasing count. The counts are stored
+/// as bin contents, so they are not limited to the range of Int_t.
+/// \param histo   The histogram, its binning is replaced
+/// \param maxPdg  Skip codes above this absolute value, if positive
+
+  std::unordered_map<Int_t, Long64_t> counts;
+  AddTo(counts, maxPdg);
+
+  histo.GetXaxis()->SetAlphanumeric();
+  histo.GetXaxis()->SetCanExtend(kTRUE);
+
+  Double_t entries = 0.;
+  for (const auto& pdgCount : counts) {
+    Int_t bin = histo.GetXaxis()->FindBin(std::to_string(pdgCount.first).c_str());
+    histo.SetBinContent(bin, static_cast<Double_t>(pdgCount.second));
+    entries += pdgCount.second;
+  }
+  histo.LabelsOption(">", "X");
+  histo.LabelsDeflate("X");
+  histo.SetEntries(entries);
+}
+
+//_____________________________________________________________________________
+void FastShowerPdgCounter::Reset()
+{
+/// Reset the counts, the slots are kept.
+
+  for (Long64_t& count : fCounts) count = 0;
+  fRareCounts.clear();
+}
+
+//_____________________________________________________________________________
+Long64_t FastShowerPdgCounter::GetCount(Int_t pdg) const
+{
+/// \return     The count of a PDG code
+/// \param pdg  The PDG code
+
+  if (pdg >= -kMaxDirectPdg && pdg <= kMaxDirectPdg) {
+    Int_t slot = fSlots[pdg + kMaxDirectPdg];
+    return slot < 0 ? 0 : fCounts[slot];
+  }
+  auto it = fRareCounts.find(pdg);
+  return it == fRareCounts.end() ? 0 : it->second;
+}
+
+//_____________________________________________________________________________
+Long64_t FastShowerPdgCounter::GetTotal() const
+{
+/// \return  The number of entries of all PDG codes
+
+  Long64_t total = 0;
+  for (Long64_t count : fCounts) total += count;
+  for (const auto& rare : fRareCounts) total += rare.second;
+  return total;
+}
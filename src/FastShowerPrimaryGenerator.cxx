@@ -23,6 +23,11 @@
 #include <TVector3.h>
 #include <TParticlePDG.h>
 #include <TDatabasePDG.h>
+#include <TMath.h>
+#include <TH1.h>
+
+#include <algorithm>
+#include <cmath>
 
 #include "FastShowerPrimaryGenerator.h"
 
@@ -37,8 +42,17 @@ FastShowerPrimaryGenerator::FastShowerPrimaryGenerator(TVirtualMCStack* stack)
     fIsRandom(false),
     fPrimaryType(kDefault),
     fNofPrimaries(1),
-    fPrimaryParticleEnergy(1.)
-
+    fPrimaryParticleEnergy(1.),
+    fProtonMass(TDatabasePDG::Instance()->GetParticle(kProton)->Mass()),
+    fSpectrum(),
+    fCosThetaMax(1.),
+    fRandoms(),
+    fVy(),
+    fVz(),
+    fE(),
+    fPx(),
+    fPy(),
+    fPz()
 {
 /// Standard constructor
 /// \param stack  The VMC stack
@@ -52,7 +66,17 @@ FastShowerPrimaryGenerator::FastShowerPrimaryGenerator(const FastShowerPrimaryGe
     fIsRandom(origin.fIsRandom),
     fPrimaryType(origin.fPrimaryType),
     fNofPrimaries(origin.fNofPrimaries),
-    fPrimaryParticleEnergy(origin.fPrimaryParticleEnergy)
+    fPrimaryParticleEnergy(origin.fPrimaryParticleEnergy),
+    fProtonMass(origin.fProtonMass),
+    fSpectrum(origin.fSpectrum),
+    fCosThetaMax(origin.fCosThetaMax),
+    fRandoms(),
+    fVy(),
+    fVz(),
+    fE(),
+    fPx(),
+    fPy(),
+    fPz()
 {
 /// Copy constructor (for clonig on worker thread in MT mode).
 /// \param origin    The source object (on master).
@@ -66,7 +90,17 @@ FastShowerPrimaryGenerator::FastShowerPrimaryGenerator()
     fIsRandom(false),
     fPrimaryType(kDefault),
     fNofPrimaries(0),
-    fPrimaryParticleEnergy(1.)
+    fPrimaryParticleEnergy(1.),
+    fProtonMass(0.),
+    fSpectrum(),
+    fCosThetaMax(1.),
+    fRandoms(),
+    fVy(),
+    fVz(),
+    fE(),
+    fPx(),
+    fPy(),
+    fPz()
 {
 /// Default constructor
 }
@@ -82,55 +116,93 @@ FastShowerPrimaryGenerator::~FastShowerPrimaryGenerator()
 //
 
 //_____________________________________________________________________________
-void FastShowerPrimaryGenerator::GeneratePrimary1(const TVector3& origin)
+void FastShowerPrimaryGenerator::GeneratePrimaryBatch(Int_t pdg, Double_t mass,
+                                                      Double_t kinEnergy,
+                                                      const TVector3& origin,
+                                                      Int_t nofPrimaries,
+                                                      const FastShowerSampler* spectrum)
 {
-/// Add one primary particle (kElectron) to the user stack
-/// (derived from TVirtualMCStack).
-/// \param origin  The track position
-
- // Track ID (filled by stack)
- Int_t ntr;
-
- // Option: to be tracked
- Int_t toBeDone = 1;
-
- // PDG
- //Int_t pdg  = kElectron;
- Int_t pdg  = kProton;
- TParticlePDG* particle = TDatabasePDG::Instance()->GetParticle(pdg);
-
- // Polarization
- Double_t polx = 0.;
- Double_t poly = 0.;
- Double_t polz = 0.;
-
- // Position
- Double_t vx  = -0.5 * origin.X();
- Double_t vy  = 0.;
- Double_t vz =  0.;
- Double_t tof = 0.;
-
- // Energy (in GeV)
- Double_t kinEnergy = fPrimaryParticleEnergy;
- Double_t mass = particle->Mass();
- //Double_t mass = 0.51099906*1e-03;
- Double_t e  = mass + kinEnergy;
+/// Add primary particles of one species to the user stack
+/// (derived from TVirtualMCStack). The random numbers for all particles are
+/// drawn at once and the kinematics is computed in plain loops over arrays
+/// before the particles are pushed.
+/// \param pdg           The PDG code
+/// \param mass          The particle mass
+/// \param kinEnergy     The kinetic energy (in GeV), used without spectrum
+/// \param origin        The track position
+/// \param nofPrimaries  The number of particles
+/// \param spectrum      The kinetic energy spectrum (optional)
+
+  if (nofPrimaries <= 0) return;
+
+  fVy.resize(nofPrimaries);
+  fVz.resize(nofPrimaries);
+  fE.resize(nofPrimaries);
+  fPx.resize(nofPrimaries);
+  fPy.resize(nofPrimaries);
+  fPz.resize(nofPrimaries);
+
+  // Randomize position, the numbers are used in the same order as when
+  // drawn per particle
+  if (fIsRandom) {
+    fRandoms.resize(2 * nofPrimaries);
+    gRandom->RndmArray(2 * nofPrimaries, fRandoms.data());
+    const Double_t* random = fRandoms.data();
+    Double_t sizeY = origin.Y();
+    Double_t sizeZ = origin.Z();
+    for (Int_t i=0; i<nofPrimaries; i++) {
+      fVy[i] = sizeY * (random[2*i] - 0.5);
+      fVz[i] = sizeZ * (random[2*i + 1] - 0.5);
+    }
+  }
+  else {
+    std::fill(fVy.begin(), fVy.end(), 0.);
+    std::fill(fVz.begin(), fVz.end(), 0.);
+  }
 
- // Particle momentum
- Double_t px, py, pz;
- px = sqrt(e*e - mass*mass);
- py = 0.;
- pz = 0.;
+  // Kinetic energy and direction: four numbers per particle, drawn only
+  // if needed so that the mono-energetic beam keeps its random sequence
+  Bool_t hasSpectrum = spectrum && !spectrum->IsEmpty();
+  Bool_t hasSpread = fCosThetaMax < 1.;
+  if (hasSpectrum || hasSpread) {
+    fRandoms.resize(4 * nofPrimaries);
+    gRandom->RndmArray(4 * nofPrimaries, fRandoms.data());
+  }
+  const Double_t* random = fRandoms.data();
+
+  // Energy and momentum
+  Double_t mass2 = mass * mass;
+  for (Int_t i=0; i<nofPrimaries; i++) {
+    Double_t energy
+      = hasSpectrum ? spectrum->Sample(random[4*i], random[4*i + 1]) : kinEnergy;
+    fE[i] = mass + energy;
+    fPx[i] = sqrt(fE[i] * fE[i] - mass2);
+  }
 
- // Randomize position
- if (fIsRandom) {
-   vy = origin.Y()*(gRandom->Rndm() - 0.5);
-   vz = origin.Z()*(gRandom->Rndm() - 0.5);
- }
+  // Direction, cos(theta) uniform around the beam (x) axis
+  if (hasSpread) {
+    for (Int_t i=0; i<nofPrimaries; i++) {
+      Double_t cosTheta = 1. - random[4*i + 2] * (1. - fCosThetaMax);
+      Double_t sinTheta = sqrt((1. - cosTheta) * (1. + cosTheta));
+      Double_t phi = TMath::TwoPi() * random[4*i + 3];
+      Double_t p = fPx[i];
+      fPx[i] = p * cosTheta;
+      fPy[i] = p * sinTheta * cos(phi);
+      fPz[i] = p * sinTheta * sin(phi);
+    }
+  }
+  else {
+    std::fill(fPy.begin(), fPy.end(), 0.);
+    std::fill(fPz.begin(), fPz.end(), 0.);
+  }
 
- // Add particle to stack
- fStack->PushTrack(toBeDone, -1, pdg, px, py, pz, e, vx, vy, vz, tof, polx, poly, polz,
-                  kPPrimary, ntr, 1., 0);
+  // Add particles to stack
+  Int_t ntr;
+  Double_t vx = -0.5 * origin.X();
+  for (Int_t i=0; i<nofPrimaries; i++) {
+    fStack->PushTrack(1, -1, pdg, fPx[i], fPy[i], fPz[i], fE[i], vx, fVy[i], fVz[i], 0.,
+                      0., 0., 0., kPPrimary, ntr, 1., 0);
+  }
 }
 
 //_____________________________________________________________________________
@@ -199,55 +271,6 @@ void FastShowerPrimaryGenerator::GeneratePrimary2(const TVector3& origin)
                   kPPrimary, ntr, 1., 0);
 }
 
-//_____________________________________________________________________________
-void FastShowerPrimaryGenerator::GeneratePrimary3(const TVector3& origin)
-{
-/// Add one primary particle (kK0Short) to the user stack
-/// (derived from TVirtualMCStack).
-/// \param origin  The track position
-
- // Track ID (filled by stack)
- Int_t ntr;
-
- // Option: to be tracked
- Int_t toBeDone = 1;
-
- // PDG
- Int_t pdg  = kK0Short;  // 310
-
- // Polarization
- Double_t polx = 0.;
- Double_t poly = 0.;
- Double_t polz = 0.;
-
- // Position
- Double_t vx  = -0.5 * origin.X();
- Double_t vy  = 0.;
- Double_t vz =  0.;
- Double_t tof = 0.;
-
- // Energy (in GeV)
- Double_t kinEnergy = 0.050;
- Double_t mass = 0.497614;
- Double_t e  = mass + kinEnergy;
-
- // Particle momentum
- Double_t px, py, pz;
- px = sqrt(e*e - mass*mass);
- py = 0.;
- pz = 0.;
-
- // Randomize position
- if (fIsRandom) {
-   vy = origin.Y()*(gRandom->Rndm() - 0.5);
-   vz = origin.Z()*(gRandom->Rndm() - 0.5);
- }
-
- // Add particle to stack
- fStack->PushTrack(toBeDone, -1, pdg, px, py, pz, e, vx, vy, vz, tof, polx, poly, polz,
-                  kPPrimary, ntr, 1., 0);
-}
-
 //_____________________________________________________________________________
 void FastShowerPrimaryGenerator::GeneratePrimary4(const TVector3& origin)
 {
@@ -337,53 +360,6 @@ void FastShowerPrimaryGenerator::GeneratePrimary4(const TVector3& origin)
 
 }
 
-//_____________________________________________________________________________
-void FastShowerPrimaryGenerator::GeneratePrimary5(const TVector3& origin)
-{
-/// Add one primary particle (kMuonPlus) to the user stack
-
- // Track ID (filled by stack)
- Int_t ntr;
-
- // Option: to be tracked
- Int_t toBeDone = 1;
-
- // PDG
- Int_t pdg  = kMuonPlus;
-
- // Polarization
- Double_t polx = 0.;
- Double_t poly = 0.;
- Double_t polz = 0.;
-
- // Position
- Double_t vx  = -0.5 * origin.X();
- Double_t vy  = 0.;
- Double_t vz =  0.;
- Double_t tof = 0.;
-
- // Energy (in GeV)
- Double_t kinEnergy = 0.1;
- Double_t mass = 0.1056583715;
- Double_t e  = mass + kinEnergy;
-
- // Particle momentum
- Double_t px, py, pz;
- px = sqrt(e*e - mass*mass);
- py = 0.;
- pz = 0.;
-
- // Randomize position
- if (fIsRandom) {
-   vy = origin.Y()*(gRandom->Rndm() - 0.5);
-   vz = origin.Z()*(gRandom->Rndm() - 0.5);
- }
-
- // Add particle to stack
- fStack->PushTrack(toBeDone, -1, pdg, px, py, pz, e, vx, vy, vz, tof, polx, poly, polz,
-                  kPPrimary, ntr, 1., 0);
-}
-
 //
 // public methods
 //
@@ -396,7 +372,8 @@ void FastShowerPrimaryGenerator::GeneratePrimaries(const TVector3& origin)
   switch ( fPrimaryType ) {
 
     case kDefault:
-      for (Int_t i=0; i<fNofPrimaries; i++) GeneratePrimary1(origin);
+      GeneratePrimaryBatch(kProton, fProtonMass, fPrimaryParticleEnergy, origin,
+                           fNofPrimaries, &fSpectrum);
       return;
 
     case kUser:
@@ -405,7 +382,7 @@ void FastShowerPrimaryGenerator::GeneratePrimaries(const TVector3& origin)
       return;
 
     case kUserDecay:
-      for (Int_t i=0; i<fNofPrimaries; i++) GeneratePrimary3(origin);
+      GeneratePrimaryBatch(kK0Short, 0.497614, 0.050, origin, fNofPrimaries);
       return;
 
     case kAnti:
@@ -414,10 +391,93 @@ void FastShowerPrimaryGenerator::GeneratePrimaries(const TVector3& origin)
       return;
 
     case kTestField:
-      for (Int_t i=0; i<fNofPrimaries; i++) GeneratePrimary5(origin);
+      GeneratePrimaryBatch(kMuonPlus, 0.1056583715, 0.1, origin, fNofPrimaries);
       return;
 
     default:
       return;
   }
 }
+
+//_____________________________________________________________________________
+Bool_t FastShowerPrimaryGenerator::SetFlatSpectrum(Double_t minEnergy, Double_t maxEnergy)
+{
+/// Generate the default primaries with a kinetic energy uniform in
+/// [minEnergy, maxEnergy).
+/// \return           False if the range is invalid, the spectrum is then unchanged
+/// \param minEnergy  The minimal kinetic energy (in GeV)
+/// \param maxEnergy  The maximal kinetic energy (in GeV)
+
+  if (minEnergy < 0. || maxEnergy <= minEnergy) {
+    Error("SetFlatSpectrum", "Invalid energy range [%g, %g]", minEnergy, maxEnergy);
+    return kFALSE;
+  }
+
+  std::vector<double> edges = { minEnergy, maxEnergy };
+  std::vector<double> weights = { 1. };
+  fSpectrum.Build(edges, weights);
+  return kTRUE;
+}
+
+//_____________________________________________________________________________
+Bool_t FastShowerPrimaryGenerator::SetPowerLawSpectrum(Double_t minEnergy, Double_t maxEnergy,
+                                                       Double_t index, Int_t nofBins)
+{
+/// Generate the default primaries with a kinetic energy spectrum
+/// dN/dE ~ E^-index in [minEnergy, maxEnergy). The spectrum is tabulated
+/// in logarithmic bins weighted with the integral of the power law and
+/// sampled uniformly within a bin.
+/// \return           False if the range is invalid, the spectrum is then unchanged
+/// \param minEnergy  The minimal kinetic energy (in GeV)
+/// \param maxEnergy  The maximal kinetic energy (in GeV)
+/// \param index      The spectral index
+/// \param nofBins    The number of bins of the table
+
+  if (minEnergy <= 0. || maxEnergy <= minEnergy || nofBins <= 0) {
+    Error("SetPowerLawSpectrum", "Invalid energy range [%g, %g] or number of bins %d",
+          minEnergy, maxEnergy, nofBins);
+    return kFALSE;
+  }
+
+  std::vector<double> edges(nofBins + 1);
+  std::vector<double> weights(nofBins);
+  Double_t logStep = log(maxEnergy / minEnergy) / nofBins;
+  for (Int_t i=0; i<=nofBins; i++) edges[i] = minEnergy * exp(i * logStep);
+  edges[nofBins] = maxEnergy;
+
+  for (Int_t i=0; i<nofBins; i++) {
+    if (TMath::Abs(index - 1.) < 1e-9)
+      weights[i] = log(edges[i+1] / edges[i]);
+    else
+      weights[i] = (pow(edges[i+1], 1. - index) - pow(edges[i], 1. - index)) / (1. - index);
+  }
+  fSpectrum.Build(edges, weights);
+  return kTRUE;
+}
+
+//_____________________________________________________________________________
+Bool_t FastShowerPrimaryGenerator::SetHistogramSpectrum(const TH1& histo)
+{
+/// Generate the default primaries with a kinetic energy distributed like
+/// the content of the given histogram (x axis in GeV).
+/// \return       False if the histogram has no positive content
+/// \param histo  The histogram
+
+  if (!fSpectrum.Build(histo)) {
+    Error("SetHistogramSpectrum", "Histogram %s has no positive content", histo.GetName());
+    return kFALSE;
+  }
+  return kTRUE;
+}
+
+//_____________________________________________________________________________
+void FastShowerPrimaryGenerator::SetAngularSpread(Double_t maxTheta)
+{
+/// Spread the primary directions uniformly in solid angle within a cone
+/// around the beam axis; zero restores the parallel beam.
+/// \param maxTheta  The cone half-angle (in rad)
+
+  if (maxTheta < 0.) maxTheta = 0.;
+  if (maxTheta > TMath::Pi()) maxTheta = TMath::Pi();
+  fCosThetaMax = cos(maxTheta);
+}
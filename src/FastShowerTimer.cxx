@@ -0,0 +1,165 @@
+/// \file FastShowerTimer.cxx
+/// \brief Implementation of the FastShowerTimer class
+
+#include <Riostream.h>
+#include <TH2D.h>
+
+#include "FastShowerTimer.h"
+
+using namespace std;
+
+//_____________________________________________________________________________
+FastShowerTimer::FastShowerTimer()
+  : fCounters(),
+    fEngineNames()
+{
+/// Default constructor
+}
+
+//
+// static methods
+//
+
+//_____________________________________________________________________________
+const char* FastShowerTimer::GetCallbackName(ECallback callback)
+{
+/// \return          The name of a callback
+/// \param callback  The callback
+
+  static const char* names[kNofCallbacks] = {
+    "GeneratePrimaries", "BeginEvent", "PreTrack", "Stepping",
+    "PostTrack", "FinishEvent", "ProcessHits", "TransferTrack" };
+
+  return names[callback];
+}
+
+//
+// private methods
+//
+
+//_____________________________________________________________________________
+void FastShowerTimer::Resize(Int_t nofEngines)
+{
+/// Provide counters for the given number of engines.
+/// \param nofEngines  The number of engines
+
+  if (nofEngines <= GetNbOfEngines()) return;
+
+  for (Int_t i=GetNbOfEngines(); i<nofEngines; i++)
+    fEngineNames.push_back("engine" + std::to_string(i));
+  Counter zero = {0, 0};
+  fCounters.resize(nofEngines * kNofCallbacks, zero);
+}
+
+//
+// public methods
+//
+
+//_____________________________________________________________________________
+void FastShowerTimer::Add(Int_t engineId, ECallback callback, Clock::duration duration)
+{
+/// Account one call of a callback.
+/// \param engineId  The engine ID, a single engine without ID counts as 0
+/// \param callback  The callback
+/// \param duration  The time spent in the callback
+
+  if (engineId < 0) engineId = 0;
+  if (engineId >= GetNbOfEngines()) Resize(engineId + 1);
+
+  Counter& counter = fCounters[engineId * kNofCallbacks + callback];
+  counter.fCalls++;
+  counter.fNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+}
+
+//_____________________________________________________________________________
+void FastShowerTimer::Add(const FastShowerTimer& other)
+{
+/// Add the counters of another timer, e.g. of a worker.
+/// \param other  The other timer
+
+  Resize(other.GetNbOfEngines());
+  for (std::size_t i=0; i<other.fCounters.size(); i++) {
+    fCounters[i].fCalls += other.fCounters[i].fCalls;
+    fCounters[i].fNanoseconds += other.fCounters[i].fNanoseconds;
+  }
+}
+
+//_____________________________________________________________________________
+void FastShowerTimer::AddHistograms(const TH1& times, const TH1& calls)
+{
+/// Add the counters stored by FillHistograms(), e.g. by another process.
+/// \param times  The time histogram
+/// \param calls  The calls histogram
+
+  Int_t nofEngines = times.GetNbinsY();
+  Resize(nofEngines);
+  for (Int_t engine=0; engine<nofEngines; engine++) {
+    fEngineNames[engine] = times.GetYaxis()->GetBinLabel(engine+1);
+    for (Int_t callback=0; callback<kNofCallbacks; callback++) {
+      Counter& counter = fCounters[engine * kNofCallbacks + callback];
+      counter.fCalls += static_cast<Long64_t>(calls.GetBinContent(callback+1, engine+1));
+      counter.fNanoseconds += static_cast<Long64_t>(times.GetBinContent(callback+1, engine+1) * 1.e9);
+    }
+  }
+}
+
+//_____________________________________________________________________________
+void FastShowerTimer::FillHistograms(TH2D& times, TH2D& calls) const
+{
+/// Fill the counters in histograms with the callbacks along x and the
+/// engines along y. They must have kNofCallbacks x GetNbOfEngines() bins.
+/// \param times  The histogram filled with the time in seconds
+/// \param calls  The histogram filled with the number of calls
+
+  for (Int_t callback=0; callback<kNofCallbacks; callback++) {
+    const char* name = GetCallbackName(static_cast<ECallback>(callback));
+    times.GetXaxis()->SetBinLabel(callback+1, name);
+    calls.GetXaxis()->SetBinLabel(callback+1, name);
+  }
+  for (Int_t engine=0; engine<GetNbOfEngines(); engine++) {
+    times.GetYaxis()->SetBinLabel(engine+1, fEngineNames[engine].c_str());
+    calls.GetYaxis()->SetBinLabel(engine+1, fEngineNames[engine].c_str());
+    for (Int_t callback=0; callback<kNofCallbacks; callback++) {
+      const Counter& counter = fCounters[engine * kNofCallbacks + callback];
+      times.SetBinContent(callback+1, engine+1, counter.fNanoseconds * 1.e-9);
+      calls.SetBinContent(callback+1, engine+1, counter.fCalls);
+    }
+  }
+}
+
+//_____________________________________________________________________________
+void FastShowerTimer::Print() const
+{
+/// Print the counters as a table.
+
+  cout << "\n-------->Callback timing (inclusive, Stepping contains ProcessHits and TransferTrack)"
+       << endl
+       << setw(14) << "engine" << setw(20) << "callback" << setw(14) << "calls"
+       << setw(14) << "total (s)" << setw(14) << "mean (us)" << endl;
+
+  for (Int_t engine=0; engine<GetNbOfEngines(); engine++) {
+    for (Int_t callback=0; callback<kNofCallbacks; callback++) {
+      const Counter& counter = fCounters[engine * kNofCallbacks + callback];
+      if (counter.fCalls == 0) continue;
+      cout << setw(14) << fEngineNames[engine]
+           << setw(20) << GetCallbackName(static_cast<ECallback>(callback))
+           << setw(14) << counter.fCalls
+           << setw(14) << counter.fNanoseconds * 1.e-9
+           << setw(14) << counter.fNanoseconds * 1.e-3 / counter.fCalls
+           << endl;
+    }
+  }
+}
+
+//_____________________________________________________________________________
+void FastShowerTimer::SetEngineName(Int_t engineId, const char* name)
+{
+/// Set the name an engine is reported with.
+/// \param engineId  The engine ID
+/// \param name      The engine name
+
+  if (engineId < 0) engineId = 0;
+  if (engineId >= GetNbOfEngines()) Resize(engineId + 1);
+
+  fEngineNames[engineId] = name;
+}
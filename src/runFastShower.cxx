@@ -1,15 +1,28 @@
 #include <vector>
 #include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <iomanip>
+
+#include <unistd.h>
+#include <sys/wait.h>
 
 #include <boost/program_options.hpp>
 
+#include <TROOT.h>
 #include <TFile.h>
+#include <TFileMerger.h>
 #include <TH1D.h>
 #include <TF1.h>
-#include <TGeoManager.h>
+#include <TGraph.h>
+#include <TParameter.h>
+#include <TRandom.h>
 
 #include "FastShowerMCApplication.h"
 #include "FastShowerPrimaryGenerator.h"
+#include "FastShowerLibrary.h"
+#include "FastShowerTimer.h"
 
 #include "FastShower.h"
 
@@ -21,132 +34,900 @@
 #include "TGeant4.h"
 
 
-void convertToBinEdges(std::vector<double>& binEdges, TH1D* histo)
+std::vector<std::string> availableCommands = { "run", "calibrate", "replay", "scan-cuts", "bench-ordering" };
+
+
+namespace bpo = boost::program_options;
+
+// print help message
+void helpMessage(const bpo::options_description& desc)
+{
+  std::cout << desc << std::endl;
+}
+
+// Settings which differ between the processes of a sharded run
+struct ShardSettings
 {
-  binEdges.resize(histo->GetNbinsX(), -1.);
-  double sum = 0.;
-  for(int i = 0; i < histo->GetNbinsX(); i++) {
-    // These will be the future bin widths
-    int binX = histo->GetBin(i+1);
-    binEdges[i] = histo->GetBinContent(binX);
-    sum += binEdges[i];
-  }
-  if(sum <= 0.) {
-    std::cerr << "Passed histogram was empty" << std::endl;
-    exit(1);
+  int nEvents = 0;             // number of events to be simulated
+  int eventOffset = 0;         // number of events simulated by previous shards
+  bool setSeed = false;        // whether the random engines should be seeded
+  unsigned int seed = 0;       // the seed to be used
+  double particleEnergy = 1.;  // kinetic energy of the primaries
+  std::string filenameOut;     // ROOT output file histograms are written to
+  std::string libraryOut;      // file recorded showers are written to, empty if not recording
+  std::string eventsOut;       // file the per-event tree is written to, empty if not storing events
+  double cutFactor = 1.;       // factor applied to the energy cuts of the "cut-media"
+  std::string stackOrdering = "lifo"; // order in which the stack pops the tracks, see "stack-ordering"
+  int monitoringLevel = 1;     // what is recorded per step, see "monitoring-level"
+};
+
+// Results read back from the output of a run in a child process
+struct ChildResult
+{
+  double realTime;     // real time of the run (s)
+  double nSteps;       // number of steps of all particles, "runSteps"
+  double depositMean;  // mean of "histDepEnergyLAr"
+  double depositSigma; // standard deviation of "histDepEnergyLAr"
+  double fitMean;      // mean of "energyDepositFit"
+  double fitSigma;     // sigma of "energyDepositFit"
+};
+
+// Insert a suffix before the extension, e.g. histograms.root -> histograms_shard2.root
+std::string suffixedFileName(const std::string& filename, const std::string& suffix)
+{
+  std::size_t extension = filename.rfind(".root");
+  if(extension == std::string::npos) {
+    return filename + suffix;
   }
-  // That is the first upper bin edge assuming the first lower bin edge is 0.
-  binEdges[0] /= sum;
-  for(int i = 1; i < binEdges.size() - 1; i++) {
-    binEdges[i] = binEdges[i-1] + binEdges[i] / sum;
+  return filename.substr(0, extension) + suffix + filename.substr(extension);
+}
+
+// Translate the name of a stack ordering policy
+bool parseStackOrdering(const std::string& name, FastShowerMCStack::EOrdering& ordering)
+{
+  if(name == "lifo") {
+    ordering = FastShowerMCStack::kLifo;
+  } else if(name == "energy") {
+    ordering = FastShowerMCStack::kEnergyOrdered;
+  } else if(name == "species") {
+    ordering = FastShowerMCStack::kPerSpecies;
+  } else {
+    return false;
   }
-  // Set the last upper bin edge explicitly to 1.
-  binEdges.back() = 1.;
+  return true;
 }
 
-std::vector<std::string> availableCommands = { "run" };
+// Derive the output file name of a shard
+std::string shardFileName(const std::string& filename, int shardIndex)
+{
+  return suffixedFileName(filename, "_shard" + std::to_string(shardIndex));
+}
 
+// Parse a comma-separated list, e.g. "11,-11,22", converting each entry
+template <typename T, typename F>
+bool parseList(const std::string& list, std::vector<T>& values, F convert)
+{
+  values.clear();
+  std::size_t start = 0;
+  while(start <= list.size()) {
+    std::size_t end = list.find(',', start);
+    if(end == std::string::npos) {
+      end = list.size();
+    }
+    try {
+      values.push_back(convert(list.substr(start, end - start)));
+    } catch(const std::exception&) {
+      return false;
+    }
+    start = end + 1;
+  }
+  return true;
+}
 
-namespace bpo = boost::program_options;
+// Parse a comma-separated list of PDG codes
+bool parsePdgList(const std::string& list, std::vector<int>& pdgs)
+{
+  return parseList(list, pdgs, [](const std::string& entry) { return std::stoi(entry); });
+}
 
-// print help message
-void helpMessage(const bpo::options_description& desc)
+// Settings of a single process run from the command line options; the
+// callers override what differs between their runs
+ShardSettings settingsFromVm(const bpo::variables_map& vm)
 {
-  std::cout << desc << std::endl;
+  ShardSettings settings;
+  settings.nEvents = vm["nevents"].as<int>();
+  settings.setSeed = vm.count("seed") > 0;
+  settings.seed = settings.setSeed ? vm["seed"].as<unsigned int>() : 0;
+  settings.particleEnergy = vm["particle-energy"].as<double>();
+  settings.filenameOut = vm["out"].as<std::string>();
+  settings.libraryOut = vm.count("record-library") ? vm["record-library"].as<std::string>() : "";
+  settings.eventsOut = vm.count("events-out") ? vm["events-out"].as<std::string>() : "";
+  settings.stackOrdering = vm["stack-ordering"].as<std::string>();
+  settings.monitoringLevel = vm["monitoring-level"].as<int>();
+  return settings;
 }
 
-int run(const bpo::variables_map& vm, std::string& errorMessage)
+int simulate(const bpo::variables_map& vm, const ShardSettings& settings, std::string& errorMessage)
 {
 
-  #ifdef G4MULTITHREADED
-    errorMessage += "WARNING: Not running multithreaded.\n";
+  int nThreads = vm["threads"].as<int>();
+  if(nThreads < 1) {
+    errorMessage += "Number of threads must be at least 1.\n";
+    return 1;
+  }
+  if(nThreads > 1) {
+  #ifndef G4MULTITHREADED
+    errorMessage += "Multi-threaded run requested but GEANT4 was built without multi-threading support.\n";
     return 1;
   #endif
+    if(vm["mode"].as<std::string>().compare("single") != 0) {
+      errorMessage += "Multi-threaded runs are only supported in mode \"single\".\n";
+      return 1;
+    }
+    // Histograms are created and filled on the worker threads
+    ROOT::EnableThreadSafety();
+  }
 
   FastShowerMCApplication* appl;
-  TGeant4* geant4;
-  TGeant3TGeo* geant3;
+  TGeant4* geant4 = nullptr;
+  TGeant3TGeo* geant3 = nullptr;
   FastShower* fastShower;
   // RunConfiguration for Geant4
   TG4RunConfiguration* runConfiguration  = new TG4RunConfiguration("geomRoot", "FTFP_BERT",
-                                                                   "stepLimiter+specialCuts+specialControls");
+                                                                   "stepLimiter+specialCuts+specialControls",
+                                                                   false, nThreads > 1);
 
   if(vm.count("fast") && !vm.count("in")) {
     errorMessage += "If \"fast\" option is specified an input file is required.\n";
   }
 
-  std::string filenameOut = vm["out"].as<std::string>();
-  std::string histNElectronsName = "histNElectrons";
+  FastShowerMCStack::EStorage stackStorage = FastShowerMCStack::kClonesArray;
+  if(vm["stack"].as<std::string>().compare("soa") == 0) {
+    stackStorage = FastShowerMCStack::kStructOfArrays;
+  } else if(vm["stack"].as<std::string>().compare("clones") != 0) {
+    errorMessage += "Unknown stack storage \"" + vm["stack"].as<std::string>() + "\".\n";
+    return 1;
+  }
+
+  const std::string& mode = vm["mode"].as<std::string>();
+  if(mode.compare("single") != 0 && mode.compare("single-g3") != 0 &&
+     mode.compare("mixed-full") != 0 && mode.compare("mixed-fast") != 0) {
+    errorMessage += "Unknown mode \"" + mode + "\".\n";
+    return 1;
+  }
+
+  FastShowerMCStack::EOrdering stackOrdering = FastShowerMCStack::kLifo;
+  if(!parseStackOrdering(settings.stackOrdering, stackOrdering)) {
+    errorMessage += "Unknown stack ordering \"" + settings.stackOrdering + "\".\n";
+    return 1;
+  }
+  // TGeant4 tracks the secondaries from its own stack and the split modes
+  // pop from the per-engine stacks of TMCManager
+  if(stackOrdering != FastShowerMCStack::kLifo && mode.compare("single-g3") != 0) {
+    errorMessage += "A stack ordering other than \"lifo\" requires mode \"single-g3\", the only mode "
+                    "in which the user stack drives the tracking.\n";
+    return 1;
+  }
+
+  if(vm["event-queue-full"].as<std::string>().compare("wait") != 0 &&
+     vm["event-queue-full"].as<std::string>().compare("drop") != 0) {
+    errorMessage += "Unknown event queue policy \"" + vm["event-queue-full"].as<std::string>() + "\".\n";
+    return 1;
+  }
+
+  const std::string& spectrum = vm["spectrum"].as<std::string>();
+  if(spectrum.compare("mono") != 0 && spectrum.compare("flat") != 0 &&
+     spectrum.compare("power-law") != 0 && spectrum.compare("histogram") != 0) {
+    errorMessage += "Unknown spectrum \"" + spectrum + "\".\n";
+    return 1;
+  }
+  if(spectrum.compare("histogram") == 0 && (!vm.count("spectrum-file") || !vm.count("spectrum-histogram"))) {
+    errorMessage += "Spectrum \"histogram\" requires \"spectrum-file\" and \"spectrum-histogram\".\n";
+    return 1;
+  }
+
+  std::vector<int> multiplicityPdgs;
+  if(!parsePdgList(vm["count-pdgs"].as<std::string>(), multiplicityPdgs)) {
+    errorMessage += "Cannot parse PDG codes \"" + vm["count-pdgs"].as<std::string>() + "\".\n";
+    return 1;
+  }
+
+  if(!settings.libraryOut.empty()) {
+    if(vm["mode"].as<std::string>().compare("single") != 0) {
+      errorMessage += "Showers can only be recorded in mode \"single\".\n";
+      return 1;
+    }
+    if(vm["part-per-event"].as<int>() != 1) {
+      errorMessage += "Showers can only be recorded with one primary per event.\n";
+      return 1;
+    }
+  }
+  if(vm["mode"].as<std::string>().compare("mixed-fast") == 0 && !vm.count("in") && !vm.count("library")) {
+    errorMessage += "Mode \"mixed-fast\" requires an input file or a shower library.\n";
+    return 1;
+  }
+
   char** argv = {};
   int argc = 0;
 
   if(vm["mode"].as<std::string>().compare("single") == 0) { // That's just a G4 run
-    appl = new FastShowerMCApplication("ExampleFastShower",  "The exampleFastShower MC application");
+    appl = new FastShowerMCApplication("ExampleFastShower",  "The exampleFastShower MC application", kFALSE, kFALSE, kFALSE, stackStorage, stackOrdering);
     // TGeant4 is needed in any case
     geant4 = new TGeant4("TGeant4", "The Geant4 Monte Carlo", runConfiguration, argc, argv);
     geant4->ProcessGeantCommand("/mcTracking/skipNeutrino true");
+    if(nThreads > 1) {
+      geant4->ProcessGeantCommand(("/run/numberOfThreads " + std::to_string(nThreads)).c_str());
+    }
+  } else if(vm["mode"].as<std::string>().compare("single-g3") == 0) { // That's just a G3 run
+    appl = new FastShowerMCApplication("ExampleFastShower",  "The exampleFastShower MC application", kFALSE, kFALSE, kFALSE, stackStorage, stackOrdering);
+    geant3 = new TGeant3TGeo("TGeant3TGeo");
   } else if(vm["mode"].as<std::string>().compare("mixed-full") == 0) { // That's with fast sim
-    appl = new FastShowerMCApplication("ExampleFastShower",  "The exampleFastShower MC application", kTRUE, kTRUE);
+    appl = new FastShowerMCApplication("ExampleFastShower",  "The exampleFastShower MC application", kTRUE, kTRUE, kFALSE, stackStorage, stackOrdering);
     // TGeant4 is needed in any case
     geant4 = new TGeant4("TGeant4", "The Geant4 Monte Carlo", runConfiguration, argc, argv);
     geant4->ProcessGeantCommand("/mcTracking/skipNeutrino true");
     geant3 = new TGeant3TGeo("TGeant3TGeo");
   } else if(vm["mode"].as<std::string>().compare("mixed-fast") == 0) {
-    appl = new FastShowerMCApplication("ExampleFastShower",  "The exampleFastShower MC application", kTRUE, kTRUE, kTRUE);
+    appl = new FastShowerMCApplication("ExampleFastShower",  "The exampleFastShower MC application", kTRUE, kTRUE, kTRUE, stackStorage, stackOrdering);
     // TGeant4 is needed in any case
     geant4 = new TGeant4("TGeant4", "The Geant4 Monte Carlo", runConfiguration, argc, argv);
     geant4->ProcessGeantCommand("/mcTracking/skipNeutrino true");
+  }
+  if(vm["mode"].as<std::string>().compare("mixed-fast") == 0 && !vm.count("library")) {
     // Take first cmd arg as path to ROOT file
     TFile file(vm["in"].as<std::string>().c_str(), "READ");
-    // Extract the histogram
-    TF1* fit = dynamic_cast<TF1*>(file.Get("energyDepositFit"));
-    Double_t parameters[3];
-    fit->GetParameters(&parameters[0]);
-    //TH1D* histNElectrons = dynamic_cast<TH1D*>(file.Get(histNElectronsName.c_str()));
-    //std::vector<double> binEdges;
-    //convertToBinEdges(binEdges, histNElectrons);
-    fastShower = new FastShower(parameters[1], parameters[2], [appl](double hitSum){ appl->GetCalorimeterSD()->SetTotalEdepGap(hitSum);});
+    // Prefer the energy-dependent parameters written by "calibrate"
+    TGraph* means = dynamic_cast<TGraph*>(file.Get("energyDepositMean"));
+    TGraph* sigmas = dynamic_cast<TGraph*>(file.Get("energyDepositSigma"));
+    auto storeHit = [appl](double hitSum){ appl->GetCalorimeterSD()->SetTotalEdepGap(hitSum);};
+    if(vm.count("sample-histogram")) {
+      // Reproduce the full shape of a histogram instead of a Gaussian
+      TH1* histogram = dynamic_cast<TH1*>(file.Get(vm["sample-histogram"].as<std::string>().c_str()));
+      FastShowerSampler sampler;
+      if(!histogram || !sampler.Build(*histogram)) {
+        errorMessage += "Histogram \"" + vm["sample-histogram"].as<std::string>() + "\" not found or empty.\n";
+        return 1;
+      }
+      fastShower = new FastShower(sampler, storeHit);
+    } else if(means && sigmas) {
+      fastShower = new FastShower(std::vector<double>(means->GetX(), means->GetX() + means->GetN()),
+                                  std::vector<double>(means->GetY(), means->GetY() + means->GetN()),
+                                  std::vector<double>(sigmas->GetY(), sigmas->GetY() + sigmas->GetN()),
+                                  storeHit);
+    } else {
+      // Extract the fit
+      TF1* fit = dynamic_cast<TF1*>(file.Get("energyDepositFit"));
+      Double_t parameters[3];
+      fit->GetParameters(&parameters[0]);
+      fastShower = new FastShower(parameters[1], parameters[2], storeHit);
+    }
+    if(settings.setSeed) {
+      fastShower->SetSeed(settings.seed);
+    }
     file.Close();
     //appl->SetTransferTrack()
   }
 
-  if(vm.count("export-geometry")) {
-    gGeoManager->Export(vm["export-geometry"].as<std::string>().c_str());
+  if(settings.setSeed) {
+    gRandom->SetSeed(settings.seed);
+    if(geant4) {
+      geant4->ProcessGeantCommand(("/random/setSeeds " + std::to_string(settings.seed) + " " +
+                                   std::to_string(settings.seed + 1)).c_str());
+    }
   }
 
 
+  appl->SetMultiplicityPdgs(multiplicityPdgs);
+  appl->SetTiming(vm.count("timing") > 0);
+  appl->SetTransferThreshold(vm["transfer-threshold"].as<double>());
+  appl->SetMonitoringLevel(settings.monitoringLevel > 0 ? FastShowerMCApplication::kStepMonitoring
+                                                        : FastShowerMCApplication::kNoMonitoring);
+  appl->SetStackCapacity(vm["stack-capacity"].as<int>());
+  if(vm.count("kill-thresholds") && !appl->ReadKillThresholds(vm["kill-thresholds"].as<std::string>())) {
+    errorMessage += "Cannot read kill thresholds " + vm["kill-thresholds"].as<std::string>() + ".\n";
+    return 1;
+  }
+  if(vm.count("routing")) {
+    if(vm["mode"].as<std::string>().compare(0, 6, "mixed-") != 0) {
+      errorMessage += "A routing map requires mode \"mixed-full\" or \"mixed-fast\".\n";
+      return 1;
+    }
+    if(!appl->ReadRoutingMap(vm["routing"].as<std::string>())) {
+      errorMessage += "Cannot read routing map " + vm["routing"].as<std::string>() + ".\n";
+      return 1;
+    }
+  }
+  appl->GetCalorimeterSD()->SetCellSegmentation(vm["cells-y"].as<int>(), vm["cells-z"].as<int>());
+  if(!settings.eventsOut.empty() &&
+     !appl->SetEventOutput(settings.eventsOut, vm["event-basket-size"].as<int>(), vm["event-compression"].as<int>())) {
+    errorMessage += "Cannot create event output file " + settings.eventsOut + ".\n";
+    return 1;
+  }
+  if(!settings.eventsOut.empty()) {
+    appl->SetEventQueue(vm["event-queue"].as<int>(), vm["event-queue-full"].as<std::string>().compare("drop") == 0);
+  }
+
+  FastShowerLibrary* library = nullptr;
+  if(vm["mode"].as<std::string>().compare("mixed-fast") == 0 && vm.count("library")) {
+    // Sample whole showers and deposit them into the calorimeter cells
+    library = FastShowerLibrary::Load(vm["library"].as<std::string>().c_str());
+    if(!library || !library->IsCompatible(*appl->GetCalorimeterSD())) {
+      errorMessage += "Shower library cannot be read or does not match the calorimeter cells.\n";
+      return 1;
+    }
+    FastShowerCalorimeterSD* calorimeterSD = appl->GetCalorimeterSD();
+    fastShower = new FastShower(library, -0.5 * appl->GetDetectorConstruction()->GetCalorThickness(),
+                                [calorimeterSD](const float* profile, double scale){ calorimeterSD->AddProfile(profile, scale);});
+    if(settings.setSeed) {
+      fastShower->SetSeed(settings.seed);
+    }
+  }
+  if(!settings.libraryOut.empty()) {
+    std::vector<double> energyEdges
+      = FastShowerLibrary::LogEnergyEdges(vm["library-energy-min"].as<double>(),
+                                          vm["library-energy-max"].as<double>(),
+                                          vm["library-energy-bins"].as<int>());
+    library = new FastShowerLibrary(energyEdges, vm["library-position-bins"].as<int>(),
+                                    appl->GetDetectorConstruction()->GetCalorSizeYZ(),
+                                    *appl->GetCalorimeterSD());
+    appl->SetShowerLibrary(library);
+  }
+
+  if(vm.count("geometry-cache")) {
+    appl->SetGeometryCache(vm["geometry-cache"].as<std::string>());
+  }
+  if(vm.count("cuts") && !appl->GetDetectorConstruction()->ReadCuts(vm["cuts"].as<std::string>().c_str())) {
+    errorMessage += "Cannot read cuts from " + vm["cuts"].as<std::string>() + ".\n";
+    return 1;
+  }
+  if(settings.cutFactor != 1.) {
+    std::vector<std::string> cutMedia;
+    parseList(vm["cut-media"].as<std::string>(), cutMedia, [](const std::string& entry) { return entry; });
+    for(const std::string& medium : cutMedia) {
+      appl->GetDetectorConstruction()->ScaleCuts(medium.c_str(), settings.cutFactor);
+    }
+  }
+
   // Run example
   appl->InitMC();
 
+  // The geometry is only closed after initialisation
+  if(vm.count("export-geometry")) {
+    appl->ExportGeometry(vm["export-geometry"].as<std::string>().c_str());
+  }
+
 
-  appl->GetPrimaryGenerator()->SetPrimaryParticleEnergy(vm["particle-energy"].as<double>());
+  appl->GetPrimaryGenerator()->SetPrimaryParticleEnergy(settings.particleEnergy);
   appl->GetPrimaryGenerator()->SetNofPrimaries(vm["part-per-event"].as<int>());
+  if(spectrum.compare("flat") == 0) {
+    if(!appl->GetPrimaryGenerator()->SetFlatSpectrum(vm["energy-min"].as<double>(), vm["energy-max"].as<double>())) {
+      errorMessage += "Invalid energy range of the \"flat\" spectrum, need 0 <= energy-min < energy-max.\n";
+      return 1;
+    }
+  } else if(spectrum.compare("power-law") == 0) {
+    if(!appl->GetPrimaryGenerator()->SetPowerLawSpectrum(vm["energy-min"].as<double>(), vm["energy-max"].as<double>(),
+                                                         vm["power-law-index"].as<double>())) {
+      errorMessage += "Invalid energy range of the \"power-law\" spectrum, need 0 < energy-min < energy-max.\n";
+      return 1;
+    }
+  } else if(spectrum.compare("histogram") == 0) {
+    TFile file(vm["spectrum-file"].as<std::string>().c_str(), "READ");
+    TH1* histo = dynamic_cast<TH1*>(file.Get(vm["spectrum-histogram"].as<std::string>().c_str()));
+    if(!histo || !appl->GetPrimaryGenerator()->SetHistogramSpectrum(*histo)) {
+      errorMessage += "Cannot sample the spectrum from histogram \"" + vm["spectrum-histogram"].as<std::string>() +
+                      "\" of " + vm["spectrum-file"].as<std::string>() + ".\n";
+      return 1;
+    }
+  }
+  appl->GetPrimaryGenerator()->SetAngularSpread(vm["angular-spread"].as<double>());
 
-  appl->RunMC(vm["nevents"].as<int>());
+  appl->SetEventOffset(settings.eventOffset);
+  appl->RunMC(settings.nEvents);
 
-  appl->WriteHistograms(filenameOut);
+  appl->WriteHistograms(settings.filenameOut);
+  if(!settings.libraryOut.empty()) {
+    library->Print();
+    library->WriteToFile(settings.libraryOut.c_str());
+  }
 
   delete appl;
+  delete library;
 
   return 0;
 
 }
 
+// Simulate in several child processes and merge their histograms
+int runShards(const bpo::variables_map& vm, int nShards, std::string& errorMessage)
+{
+  int nEvents = vm["nevents"].as<int>();
+  std::string filenameOut = vm["out"].as<std::string>();
+  // Do not use 0 since that would make TRandom3 seed from the time
+  unsigned int baseSeed = vm.count("seed") ? vm["seed"].as<unsigned int>() : 1;
+
+  std::vector<pid_t> children;
+  std::vector<std::string> shardFiles;
+  int eventOffset = 0;
+  for(int i = 0; i < nShards; i++) {
+    ShardSettings settings = settingsFromVm(vm);
+    settings.nEvents = nEvents / nShards + (i < nEvents % nShards ? 1 : 0);
+    settings.eventOffset = eventOffset;
+    settings.setSeed = true;
+    settings.seed = baseSeed + i;
+    settings.filenameOut = shardFileName(filenameOut, i);
+    settings.libraryOut = vm.count("record-library") ? shardFileName(vm["record-library"].as<std::string>(), i) : "";
+    settings.eventsOut = vm.count("events-out") ? shardFileName(vm["events-out"].as<std::string>(), i) : "";
+    eventOffset += settings.nEvents;
+    shardFiles.push_back(settings.filenameOut);
+
+    pid_t pid = fork();
+    if(pid < 0) {
+      errorMessage += "Could not fork process for shard " + std::to_string(i) + ".\n";
+      break;
+    }
+    if(pid == 0) {
+      // That's the child, it never returns to the caller
+      std::cout << "Shard " << i << " simulates events [" << settings.eventOffset << ", "
+                << settings.eventOffset + settings.nEvents << ") with seed " << settings.seed
+                << std::endl;
+      std::string shardErrorMessage;
+      int returnValue = simulate(vm, settings, shardErrorMessage);
+      if(returnValue > 0) {
+        std::cerr << "ERRORS occured in shard " << i << ":" << shardErrorMessage << std::endl;
+      }
+      std::exit(returnValue);
+    }
+    children.push_back(pid);
+  }
+
+  // Wait for all shards, also if one of them failed
+  bool success = children.size() == static_cast<std::size_t>(nShards);
+  for(std::size_t i = 0; i < children.size(); i++) {
+    int status = 0;
+    if(waitpid(children[i], &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      errorMessage += "Shard " + std::to_string(i) + " failed.\n";
+      success = false;
+    }
+  }
+  if(!success) {
+    return 1;
+  }
+
+  // Merge the shard outputs, the fit is redone on the merged histogram
+  FastShowerMCApplication merged("ExampleFastShower",  "The exampleFastShower MC application");
+  std::vector<int> multiplicityPdgs;
+  parsePdgList(vm["count-pdgs"].as<std::string>(), multiplicityPdgs);
+  merged.SetMultiplicityPdgs(multiplicityPdgs);
+  merged.SetTiming(vm.count("timing") > 0);
+  for(const std::string& shardFile : shardFiles) {
+    merged.MergeHistograms(shardFile);
+  }
+  if(merged.GetTimer()) {
+    merged.GetTimer()->Print();
+  }
+  merged.WriteHistograms(filenameOut);
+
+  // Merge the recorded shower libraries
+  std::vector<std::string> libraryFiles;
+  if(vm.count("record-library")) {
+    FastShowerLibrary* mergedLibrary = nullptr;
+    for(int i = 0; i < nShards; i++) {
+      libraryFiles.push_back(shardFileName(vm["record-library"].as<std::string>(), i));
+      FastShowerLibrary* library = FastShowerLibrary::Load(libraryFiles.back().c_str());
+      if(!library) {
+        errorMessage += "Cannot read shower library of shard " + std::to_string(i) + ".\n";
+        delete mergedLibrary;
+        return 1;
+      }
+      if(!mergedLibrary) {
+        mergedLibrary = library;
+        continue;
+      }
+      mergedLibrary->Add(*library);
+      delete library;
+    }
+    mergedLibrary->Print();
+    mergedLibrary->WriteToFile(vm["record-library"].as<std::string>().c_str());
+    delete mergedLibrary;
+  }
+
+  // Concatenate the event trees in the order of the shards
+  std::vector<std::string> eventFiles;
+  if(vm.count("events-out")) {
+    TFileMerger merger(kFALSE);
+    merger.OutputFile(vm["events-out"].as<std::string>().c_str(), "RECREATE", vm["event-compression"].as<int>());
+    for(int i = 0; i < nShards; i++) {
+      eventFiles.push_back(shardFileName(vm["events-out"].as<std::string>(), i));
+      merger.AddFile(eventFiles.back().c_str(), kFALSE);
+    }
+    if(!merger.Merge()) {
+      errorMessage += "Cannot merge the event trees of the shards.\n";
+      return 1;
+    }
+  }
+
+  if(!vm.count("keep-shards")) {
+    for(const std::string& shardFile : shardFiles) {
+      std::remove(shardFile.c_str());
+    }
+    for(const std::string& libraryFile : libraryFiles) {
+      std::remove(libraryFile.c_str());
+    }
+    for(const std::string& eventFile : eventFiles) {
+      std::remove(eventFile.c_str());
+    }
+  }
+  return 0;
+}
+
+// Simulate in a child process, since the engines can only be initialised
+// once per process, and read back the results. The caller waits for the
+// child, so that the timings of consecutive runs do not interfere. The
+// output file is removed afterwards unless "keep-shards" is given.
+bool runChild(const bpo::variables_map& vm, const ShardSettings& settings, const std::string& label,
+              ChildResult& result, std::string& errorMessage)
+{
+  pid_t pid = fork();
+  if(pid < 0) {
+    errorMessage += "Could not fork process for " + label + ".\n";
+    return false;
+  }
+  if(pid == 0) {
+    std::cout << "Simulating " << label << std::endl;
+    std::string childErrorMessage;
+    int returnValue = simulate(vm, settings, childErrorMessage);
+    if(returnValue > 0) {
+      std::cerr << "ERRORS occured for " << label << ":" << childErrorMessage << std::endl;
+    }
+    std::exit(returnValue);
+  }
+  int status = 0;
+  if(waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    errorMessage += "Run for " + label + " failed.\n";
+    return false;
+  }
+
+  TFile file(settings.filenameOut.c_str(), "READ");
+  TH1* deposit = dynamic_cast<TH1*>(file.Get("histDepEnergyLAr"));
+  TParameter<Long64_t>* steps = dynamic_cast<TParameter<Long64_t>*>(file.Get("runSteps"));
+  TF1* fit = dynamic_cast<TF1*>(file.Get("energyDepositFit"));
+  TParameter<Double_t>* realTime = dynamic_cast<TParameter<Double_t>*>(file.Get("runRealTime"));
+  bool complete = deposit && steps && fit && realTime;
+  if(complete) {
+    result.realTime = realTime->GetVal();
+    result.nSteps = steps->GetVal();
+    result.depositMean = deposit->GetMean();
+    result.depositSigma = deposit->GetStdDev();
+    result.fitMean = fit->GetParameter(1);
+    result.fitSigma = fit->GetParameter(2);
+  } else {
+    errorMessage += "Incomplete output in " + settings.filenameOut + ".\n";
+  }
+  file.Close();
+  if(!vm.count("keep-shards")) {
+    std::remove(settings.filenameOut.c_str());
+  }
+  return complete;
+}
+
+int run(const bpo::variables_map& vm, std::string& errorMessage)
+{
+  int nShards = vm["shards"].as<int>();
+  if(nShards < 1 || nShards > vm["nevents"].as<int>()) {
+    errorMessage += "Number of shards must be between 1 and the number of events.\n";
+    return 1;
+  }
+  if(nShards > 1) {
+    return runShards(vm, nShards, errorMessage);
+  }
+
+  return simulate(vm, settingsFromVm(vm), errorMessage);
+}
+
+// Run the full simulation at each point of an energy grid and store the
+// energy deposit parameters as a function of the primary kinetic energy
+int calibrate(const bpo::variables_map& vm, std::string& errorMessage)
+{
+  std::vector<double> energies;
+  if(!parseList(vm["energies"].as<std::string>(), energies, [](const std::string& entry) { return std::stod(entry); })) {
+    errorMessage += "Cannot parse energies \"" + vm["energies"].as<std::string>() + "\".\n";
+    return 1;
+  }
+  std::sort(energies.begin(), energies.end());
+  if(vm["mode"].as<std::string>().compare("single") != 0 || vm.count("record-library")) {
+    errorMessage += "Calibration runs the full simulation in mode \"single\" only.\n";
+    return 1;
+  }
+  if(vm["spectrum"].as<std::string>().compare("mono") != 0) {
+    errorMessage += "Calibration requires mono-energetic primaries.\n";
+    return 1;
+  }
+
+  std::string filenameOut = vm["out"].as<std::string>();
+  TGraph means(energies.size(), energies.data(), energies.data());
+  TGraph sigmas(energies.size(), energies.data(), energies.data());
+  means.SetName("energyDepositMean");
+  sigmas.SetName("energyDepositSigma");
+
+  for(std::size_t i = 0; i < energies.size(); i++) {
+    ShardSettings settings = settingsFromVm(vm);
+    settings.particleEnergy = energies[i];
+    settings.filenameOut = suffixedFileName(filenameOut, "_calib" + std::to_string(i));
+    settings.eventsOut = "";
+
+    ChildResult result;
+    if(!runChild(vm, settings, "kinetic energy " + std::to_string(energies[i]) + " GeV", result, errorMessage)) {
+      return 1;
+    }
+    means.SetPoint(i, energies[i], result.fitMean);
+    sigmas.SetPoint(i, energies[i], result.fitSigma);
+  }
+
+  TFile file(filenameOut.c_str(), "RECREATE");
+  file.WriteTObject(&means);
+  file.WriteTObject(&sigmas);
+  file.Close();
+  return 0;
+}
+
+// Run the same configuration over a grid of cut factors and measure the
+// throughput and the change of the energy deposit against the finest cuts
+int scanCuts(const bpo::variables_map& vm, std::string& errorMessage)
+{
+  std::vector<double> factors;
+  if(!parseList(vm["cut-factors"].as<std::string>(), factors, [](const std::string& entry) { return std::stod(entry); })) {
+    errorMessage += "Cannot parse cut factors \"" + vm["cut-factors"].as<std::string>() + "\".\n";
+    return 1;
+  }
+  // The finest cuts are the reference
+  std::sort(factors.begin(), factors.end());
+  if(factors.front() <= 0.) {
+    errorMessage += "Cut factors must be positive.\n";
+    return 1;
+  }
+  if(vm["shards"].as<int>() > 1 || vm.count("record-library")) {
+    errorMessage += "A cut scan runs single processes without recording a library.\n";
+    return 1;
+  }
+
+  std::string filenameOut = vm["out"].as<std::string>();
+  std::size_t nPoints = factors.size();
+  std::vector<double> eventsPerSecond(nPoints);
+  std::vector<double> stepsPerEvent(nPoints);
+  std::vector<double> means(nPoints);
+  std::vector<double> sigmas(nPoints);
+
+  for(std::size_t i = 0; i < nPoints; i++) {
+    ShardSettings settings = settingsFromVm(vm);
+    // Same seed for all points so that only the cuts differ
+    settings.setSeed = true;
+    settings.seed = vm.count("seed") ? vm["seed"].as<unsigned int>() : 1;
+    settings.cutFactor = factors[i];
+    // The steps per event are read back from the histograms
+    settings.monitoringLevel = FastShowerMCApplication::kStepMonitoring;
+    settings.filenameOut = suffixedFileName(filenameOut, "_cuts" + std::to_string(i));
+    settings.eventsOut = "";
+
+    ChildResult result;
+    if(!runChild(vm, settings, "cut factor " + std::to_string(factors[i]), result, errorMessage)) {
+      return 1;
+    }
+    eventsPerSecond[i] = result.realTime > 0. ? settings.nEvents / result.realTime : 0.;
+    stepsPerEvent[i] = result.nSteps / settings.nEvents;
+    means[i] = result.depositMean;
+    sigmas[i] = result.depositSigma;
+  }
+
+  TGraph throughput(static_cast<Int_t>(nPoints));
+  TGraph steps(static_cast<Int_t>(nPoints));
+  TGraph meanShift(static_cast<Int_t>(nPoints));
+  TGraph sigmaShift(static_cast<Int_t>(nPoints));
+  throughput.SetName("cutScanEventsPerSecond");
+  steps.SetName("cutScanStepsPerEvent");
+  meanShift.SetName("cutScanMeanShift");
+  sigmaShift.SetName("cutScanSigmaShift");
+
+  std::cout << "\n-------->Cut scan of " << vm["cut-media"].as<std::string>()
+            << " (shifts relative to factor " << factors.front() << ")" << std::endl
+            << std::setw(10) << "factor" << std::setw(14) << "events/s" << std::setw(14) << "steps/event"
+            << std::setw(14) << "mean (GeV)" << std::setw(14) << "sigma (GeV)"
+            << std::setw(14) << "mean shift" << std::setw(14) << "sigma shift" << std::endl;
+  for(std::size_t i = 0; i < nPoints; i++) {
+    double dMean = means[0] != 0. ? means[i] / means[0] - 1. : 0.;
+    double dSigma = sigmas[0] != 0. ? sigmas[i] / sigmas[0] - 1. : 0.;
+    throughput.SetPoint(i, factors[i], eventsPerSecond[i]);
+    steps.SetPoint(i, factors[i], stepsPerEvent[i]);
+    meanShift.SetPoint(i, factors[i], dMean);
+    sigmaShift.SetPoint(i, factors[i], dSigma);
+    std::cout << std::setw(10) << factors[i] << std::setw(14) << eventsPerSecond[i]
+              << std::setw(14) << stepsPerEvent[i] << std::setw(14) << means[i]
+              << std::setw(14) << sigmas[i] << std::setw(14) << dMean
+              << std::setw(14) << dSigma << std::endl;
+  }
+
+  TFile file(filenameOut.c_str(), "RECREATE");
+  file.WriteTObject(&throughput);
+  file.WriteTObject(&steps);
+  file.WriteTObject(&meanShift);
+  file.WriteTObject(&sigmaShift);
+  file.Close();
+  return 0;
+}
+
+// Run the same configuration with each stack ordering policy and compare
+// the tracking throughput
+int benchOrdering(const bpo::variables_map& vm, std::string& errorMessage)
+{
+  std::vector<std::string> orderings;
+  parseList(vm["orderings"].as<std::string>(), orderings, [](const std::string& entry) { return entry; });
+  for(const std::string& ordering : orderings) {
+    FastShowerMCStack::EOrdering value;
+    if(!parseStackOrdering(ordering, value)) {
+      errorMessage += "Unknown stack ordering \"" + ordering + "\".\n";
+      return 1;
+    }
+  }
+  if(orderings.empty()) {
+    errorMessage += "No stack ordering given.\n";
+    return 1;
+  }
+  if(vm["shards"].as<int>() > 1 || vm.count("record-library")) {
+    errorMessage += "An ordering benchmark runs single processes without recording a library.\n";
+    return 1;
+  }
+  if(vm["mode"].as<std::string>().compare("single-g3") != 0) {
+    errorMessage += "An ordering benchmark requires mode \"single-g3\", the only mode in which the "
+                    "user stack drives the tracking.\n";
+    return 1;
+  }
+
+  std::string filenameOut = vm["out"].as<std::string>();
+  std::size_t nPoints = orderings.size();
+  std::vector<double> stepsPerSecond(nPoints);
+  std::vector<double> eventsPerSecond(nPoints);
+  std::vector<double> stepsPerEvent(nPoints);
+
+  for(std::size_t i = 0; i < nPoints; i++) {
+    ShardSettings settings = settingsFromVm(vm);
+    // Same seed for all policies so that only the track order differs
+    settings.setSeed = true;
+    settings.seed = vm.count("seed") ? vm["seed"].as<unsigned int>() : 1;
+    settings.stackOrdering = orderings[i];
+    // The steps per event are read back from the histograms
+    settings.monitoringLevel = FastShowerMCApplication::kStepMonitoring;
+    settings.filenameOut = suffixedFileName(filenameOut, "_" + orderings[i]);
+    settings.eventsOut = "";
+
+    ChildResult result;
+    if(!runChild(vm, settings, "stack ordering " + orderings[i], result, errorMessage)) {
+      return 1;
+    }
+    stepsPerSecond[i] = result.realTime > 0. ? result.nSteps / result.realTime : 0.;
+    eventsPerSecond[i] = result.realTime > 0. ? settings.nEvents / result.realTime : 0.;
+    stepsPerEvent[i] = result.nSteps / settings.nEvents;
+  }
+
+  TH1D histStepsPerSecond("orderingStepsPerSecond", "steps per second", nPoints, 0., nPoints);
+  TH1D histEventsPerSecond("orderingEventsPerSecond", "events per second", nPoints, 0., nPoints);
+  TH1D histStepsPerEvent("orderingStepsPerEvent", "steps per event", nPoints, 0., nPoints);
+
+  std::cout << "\n-------->Stack ordering benchmark" << std::endl
+            << std::setw(10) << "ordering" << std::setw(14) << "steps/s" << std::setw(14) << "events/s"
+            << std::setw(14) << "steps/event" << std::setw(14) << "speedup" << std::endl;
+  for(std::size_t i = 0; i < nPoints; i++) {
+    double speedup = stepsPerSecond[0] > 0. ? stepsPerSecond[i] / stepsPerSecond[0] : 0.;
+    for(TH1D* histogram : {&histStepsPerSecond, &histEventsPerSecond, &histStepsPerEvent}) {
+      histogram->GetXaxis()->SetBinLabel(i + 1, orderings[i].c_str());
+    }
+    histStepsPerSecond.SetBinContent(i + 1, stepsPerSecond[i]);
+    histEventsPerSecond.SetBinContent(i + 1, eventsPerSecond[i]);
+    histStepsPerEvent.SetBinContent(i + 1, stepsPerEvent[i]);
+    std::cout << std::setw(10) << orderings[i] << std::setw(14) << stepsPerSecond[i]
+              << std::setw(14) << eventsPerSecond[i] << std::setw(14) << stepsPerEvent[i]
+              << std::setw(14) << speedup << std::endl;
+  }
+
+  TFile file(filenameOut.c_str(), "RECREATE");
+  file.WriteTObject(&histStepsPerSecond);
+  file.WriteTObject(&histEventsPerSecond);
+  file.WriteTObject(&histStepsPerEvent);
+  file.Close();
+  return 0;
+}
+
+// Fill the histograms from the events stored by a previous run instead of
+// simulating them again
+int replay(const bpo::variables_map& vm, std::string& errorMessage)
+{
+  if(!vm.count("in")) {
+    errorMessage += "An event file written with \"events-out\" is required.\n";
+    return 1;
+  }
+
+  FastShowerMCApplication appl("ExampleFastShower",  "The exampleFastShower MC application");
+  if(!appl.SetEventInput(vm["in"].as<std::string>())) {
+    errorMessage += "Cannot read events from " + vm["in"].as<std::string>() + ".\n";
+    return 1;
+  }
+  Long64_t nEvents = appl.GetNbOfStoredEvents();
+  for(Long64_t i = 0; i < nEvents; i++) {
+    appl.ReadEvent(static_cast<Int_t>(i));
+  }
+  std::cout << "Replayed " << nEvents << " events" << std::endl;
+  appl.WriteHistograms(vm["out"].as<std::string>());
+  return 0;
+}
+
 // Initialize everything for the final run depending on the command
 void initializeForRun(const std::string& cmd, bpo::options_description& cmdOptionsDescriptions, std::function<int(const bpo::variables_map&, std::string&)>& cmdFunction)
 {
-  if (cmd == "run") {
+  if (cmd == "run" || cmd == "calibrate" || cmd == "scan-cuts" || cmd == "bench-ordering") {
     cmdOptionsDescriptions.add_options()("help,h", "show this help message and exit")(
-                                         "mode,m", bpo::value<std::string>()->default_value("single"), "choose mode between \"single\", \"mixed-full\", \"mixed-fast\"")(
+                                         "mode,m", bpo::value<std::string>()->default_value("single"), "choose mode between \"single\" (GEANT4), \"single-g3\" (GEANT3), \"mixed-full\", \"mixed-fast\"")(
                                          "nevents,n", bpo::value<int>()->default_value(5), "choose number of generated events")(
                                          "part-per-event,p", bpo::value<int>()->default_value(1), "choose number of primary particles events")(
                                          "single-g4,s", bpo::value<std::string>(), "run only GEANT4")("fast,f", "run GEANT4 with fast sim")(
                                          "in,i", bpo::value<std::string>(), "ROOT input file containing histograms for fast sim")(
                                          "out,o", bpo::value<std::string>()->default_value("./histograms.root"), "ROOT output file histograms should be written to")(
-                                         "export-geometry,e", bpo::value<std::string>()->default_value("./geometry.root"), "export geometry")(
-                                         "particle-energy,c", bpo::value<double>()->default_value(1.), "primary particle energy");
+                                         "export-geometry,e", bpo::value<std::string>(), "export the closed geometry to this file")(
+                                         "geometry-cache", bpo::value<std::string>(), "directory where the geometry is cached per calorimeter parameters")(
+                                         "cuts", bpo::value<std::string>(), "text file with the production cuts and process controls per medium, see macro/cuts.dat")(
+                                         "particle-energy,c", bpo::value<double>()->default_value(1.), "primary particle energy")(
+                                         "spectrum", bpo::value<std::string>()->default_value("mono"), "kinetic energy spectrum of the primaries, \"mono\" (\"particle-energy\"), \"flat\", \"power-law\" or \"histogram\"")(
+                                         "energy-min", bpo::value<double>()->default_value(0.1), "lower edge of the \"flat\" and \"power-law\" spectra (GeV)")(
+                                         "energy-max", bpo::value<double>()->default_value(10.), "upper edge of the \"flat\" and \"power-law\" spectra (GeV)")(
+                                         "power-law-index", bpo::value<double>()->default_value(2.), "spectral index of the \"power-law\" spectrum, dN/dE ~ E^-index")(
+                                         "spectrum-file", bpo::value<std::string>(), "ROOT file with the histogram of the \"histogram\" spectrum")(
+                                         "spectrum-histogram", bpo::value<std::string>(), "name of the kinetic energy histogram (GeV) of the \"histogram\" spectrum")(
+                                         "angular-spread", bpo::value<double>()->default_value(0.), "half-angle (rad) of the cone around the beam axis the primary directions are drawn in uniformly")(
+                                         "threads,t", bpo::value<int>()->default_value(1), "number of worker threads (mode \"single\" only)")(
+                                         "shards", bpo::value<int>()->default_value(1), "number of processes the events are distributed over")(
+                                         "seed", bpo::value<unsigned int>(), "seed of the random engines (base seed of the shards)")(
+                                         "keep-shards", "keep the output files of the single shards")(
+                                         "stack", bpo::value<std::string>()->default_value("clones"), "particle storage of the stack, \"clones\" or \"soa\"")(
+                                         "stack-ordering", bpo::value<std::string>()->default_value("lifo"), "order in which the stack pops the tracks, \"lifo\", \"energy\" (highest first) or \"species\" (one species after the other); other than \"lifo\" in mode \"single-g3\" only")(
+                                         "stack-capacity", bpo::value<int>()->default_value(1000), "number of tracks per event the stack storage is allocated for up front")(
+                                         "count-pdgs", bpo::value<std::string>()->default_value("11,-11,22"), "comma-separated PDG codes whose multiplicity per event is histogrammed")(
+                                         "cells-y", bpo::value<int>()->default_value(1), "number of calorimeter cells per layer along y")(
+                                         "cells-z", bpo::value<int>()->default_value(1), "number of calorimeter cells per layer along z")(
+                                         "record-library", bpo::value<std::string>(), "record the calorimeter showers into this shower library file (mode \"single\")")(
+                                         "library", bpo::value<std::string>(), "shower library sampled by the fast simulation (mode \"mixed-fast\")")(
+                                         "library-energy-min", bpo::value<double>()->default_value(0.1), "lower edge of the library energy bins (GeV)")(
+                                         "library-energy-max", bpo::value<double>()->default_value(100.), "upper edge of the library energy bins (GeV)")(
+                                         "library-energy-bins", bpo::value<int>()->default_value(10), "number of library energy bins (logarithmic)")(
+                                         "library-position-bins", bpo::value<int>()->default_value(1), "number of library entry position bins along y and z")(
+                                         "sample-histogram", bpo::value<std::string>(), "histogram of the input file the fast simulation draws the deposit from, e.g. \"histDepEnergyLAr\"")(
+                                         "timing", "time the user callbacks per engine")(
+                                         "monitoring-level", bpo::value<int>()->default_value(1), "0 records nothing per step besides the calorimeter hits, 1 also fills the step, boundary and species histograms")(
+                                         "kill-thresholds", bpo::value<std::string>(), "text file with the energies per medium and species below which secondaries are not tracked, see macro/kill.dat")(
+                                         "routing", bpo::value<std::string>(), "text file mapping volumes, species and energies to the engines of the split simulation, see macro/routing.dat")(
+                                         "transfer-threshold", bpo::value<double>()->default_value(0.), "tracks below this kinetic energy (GeV) stay in their engine instead of being transferred (modes \"mixed-full\", \"mixed-fast\")")(
+                                         "events-out", bpo::value<std::string>(), "store the calorimeter cells and summaries of each event in a tree in this file")(
+                                         "event-basket-size", bpo::value<int>()->default_value(32000), "basket size of the event tree branches (bytes)")(
+                                         "event-compression", bpo::value<int>()->default_value(101), "ROOT compression settings of the event file (100 * algorithm + level)")(
+                                         "event-queue", bpo::value<int>()->default_value(64), "number of events queued for the event writer thread")(
+                                         "event-queue-full", bpo::value<std::string>()->default_value("wait"), "if the event queue is full, \"wait\" for the writer or \"drop\" the event");
     cmdFunction = run;
   }
+  if (cmd == "calibrate") {
+    cmdOptionsDescriptions.add_options()("energies", bpo::value<std::string>()->default_value("0.5,1,2,5,10"), "comma-separated grid of primary kinetic energies (GeV) replacing \"particle-energy\"");
+    cmdFunction = calibrate;
+  }
+  if (cmd == "scan-cuts") {
+    cmdOptionsDescriptions.add_options()("cut-factors", bpo::value<std::string>()->default_value("1,2,5,10"), "comma-separated factors the energy cuts are multiplied with, the smallest is the reference")(
+                                         "cut-media", bpo::value<std::string>()->default_value("Lead,liquidArgon"), "comma-separated media whose energy cuts are scaled");
+    cmdFunction = scanCuts;
+  }
+  if (cmd == "bench-ordering") {
+    cmdOptionsDescriptions.add_options()("orderings", bpo::value<std::string>()->default_value("lifo,energy,species"), "comma-separated stack ordering policies to be compared");
+    cmdFunction = benchOrdering;
+  }
+  if (cmd == "replay") {
+    cmdOptionsDescriptions.add_options()("help,h", "show this help message and exit")(
+                                         "in,i", bpo::value<std::string>(), "ROOT file with the event tree written with \"events-out\"")(
+                                         "out,o", bpo::value<std::string>()->default_value("./histograms.root"), "ROOT output file histograms should be written to");
+    cmdFunction = replay;
+  }
 }
 
 
@@ -164,7 +945,7 @@ int main(int argc, char** argv)
   bpo::variables_map vm;
   // Description of the available top-level commands/options
   bpo::options_description desc("Available commands/options");
-  desc.add_options()("help,h", "show this help message and exit")("command", bpo::value<std::string>(), "command to be executed (\"run\")")("positional", bpo::value<std::vector<std::string>>(), "positional arguments");
+  desc.add_options()("help,h", "show this help message and exit")("command", bpo::value<std::string>(), "command to be executed (\"run\", \"calibrate\", \"scan-cuts\", \"bench-ordering\", \"replay\")")("positional", bpo::value<std::vector<std::string>>(), "positional arguments");
   // Dedicated description for positional arguments
   bpo::positional_options_description pos;
   // First positional argument is actually the command, all others are real positional arguments "( "positional", -1 )"